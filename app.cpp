@@ -17,9 +17,12 @@
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtWidgets/QMessageBox>
 
+#include "autosave.h"
 #include "global_hotkeys.h"
 #include "logger.h"
+#include "memory_budget.h"
 #include "preferences.h"
+#include "redraw_scheduler.h"
 #include "reference_collection.h"
 #include "reference_image.h"
 #include "reference_loading.h"
@@ -361,12 +364,15 @@ bool App::saveSession()
         }
         m_saveFilePath = std::move(filePath);
     }
-    if (!sessionSaving::saveSession(m_saveFilePath))
+    bool complete = true;
+    if (!sessionSaving::saveSession(m_saveFilePath, true, &complete))
     {
         showSaveErrorMsgBox(this);
         return false;
     }
-    m_hasUnsavedChanges = false;
+    // Images that are still downloading are saved by the next save
+    m_hasUnsavedChanges = !complete;
+    m_autosave->discardRecoveryFiles();
     refreshWindowName();
     return true;
 }
@@ -430,12 +436,18 @@ void App::newSession(bool force)
     m_referenceItems->clear();
     m_undoStack->clear();
     m_saveFilePath.clear();
+    sessionSaving::closeSession();
+    m_autosave->discardRecoveryFiles();
     setUnsavedChanges(false);
     refreshWindowName();
 }
 
 void App::setUnsavedChanges(bool value)
 {
+    if (value)
+    {
+        ++m_changeCount;
+    }
     if (value != m_hasUnsavedChanges)
     {
         m_hasUnsavedChanges = value;
@@ -489,6 +501,7 @@ void App::initMsgBox(QMessageBox &msgBox) const
 
 void App::onStartUp()
 {
+    restoreAutosave();
     processCommandLineArgs();
 
     // Create an empty reference window if none have been added
@@ -552,6 +565,41 @@ void App::processCommandLineArgs()
     }
 }
 
+void App::restoreAutosave()
+{
+    const QStringList recoveryFiles = Autosave::recoveryFiles();
+    if (recoveryFiles.isEmpty())
+    {
+        return;
+    }
+
+    QMessageBox msgBox(QMessageBox::Question, "Ghost Reference",
+                       "Ghost Reference did not close properly. Restore the autosaved session?",
+                       QMessageBox::Yes | QMessageBox::No);
+    initMsgBox(msgBox);
+
+    if (msgBox.exec() != QMessageBox::Yes)
+    {
+        Autosave::removeRecoveryFiles();
+        return;
+    }
+
+    // Try the older recovery file if the newest can't be loaded
+    for (const QString &recoveryFile : recoveryFiles)
+    {
+        if (sessionSaving::loadSession(recoveryFile))
+        {
+            m_saveFilePath = Autosave::originalSessionFile(recoveryFile);
+            // Keep the recovery files until the restored session is saved or closed
+            m_autosave->adoptRecoveryFiles();
+            setUnsavedChanges(true);
+            refreshWindowName();
+            return;
+        }
+        qWarning() << "Unable to restore autosaved session" << recoveryFile;
+    }
+}
+
 void App::refreshWindowName()
 {
     const QString baseName = applicationDisplayName();
@@ -586,10 +634,13 @@ App::App(int &argc, char **argv, int flags, const Preferences *prefs)
 
     m_logger->removeOldLogFiles();
 
+    m_redrawScheduler = new RedrawScheduler(this);
+    m_memoryBudget = new MemoryBudget(this);
     m_backWindow = new BackWindow();
     m_globalHotkeys = new GlobalHotkeys(this);
     m_mainToolbar = new MainToolbar(m_backWindow);
     m_undoStack = new UndoStack(this);
+    m_autosave = new Autosave(this);
 
     refreshWindowName();
     loadStyleSheetFor(this);
@@ -601,4 +652,8 @@ App::App(int &argc, char **argv, int flags, const Preferences *prefs)
     m_mainToolbar->show();
 }
 
-App::~App() = default;
+App::~App()
+{
+    // The session was closed normally so the recovery files aren't needed
+    m_autosave->discardRecoveryFiles();
+}
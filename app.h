@@ -37,9 +37,13 @@ private:
     GlobalHotkeys *m_globalHotkeys = nullptr;
     QNetworkAccessManager *m_networkManager = nullptr;
     UndoStack *m_undoStack;
+    Autosave *m_autosave = nullptr;
+    RedrawScheduler *m_redrawScheduler = nullptr;
+    MemoryBudget *m_memoryBudget = nullptr;
 
     bool m_allRefWindowsVisible = true;
     bool m_hasUnsavedChanges = false;
+    qint64 m_changeCount = 0;
 
     Qt::KeyboardModifiers m_overrideKeys;
 
@@ -76,6 +80,9 @@ public:
     GlobalHotkeys *globalHotkeys() const;
 
     UndoStack *undoStack() const;
+    Autosave *autosave() const;
+    RedrawScheduler *redrawScheduler() const;
+    MemoryBudget *memoryBudget() const;
 
     const RefWindowList &referenceWindows() const;
     const ReferenceCollection *referenceItems() const;
@@ -104,6 +111,9 @@ public:
 
     bool hasUnsavedChanges() const;
     void setUnsavedChanges(bool value = true);
+    // Increased by each change to the session. Used to tell whether the session changed since it was last
+    // looked at (e.g. by autosave).
+    qint64 changeCount() const;
 
     bool allRefWindowsVisible() const;
     void setAllRefWindowsVisible(bool value);
@@ -147,6 +157,8 @@ protected:
 private:
     void cleanWindowList();
     void processCommandLineArgs();
+    // Asks the user to restore the autosaved session if the application didn't exit cleanly
+    void restoreAutosave();
     void refreshWindowName();
 };
 
@@ -174,6 +186,21 @@ inline UndoStack *App::undoStack() const
     return m_undoStack;
 }
 
+inline Autosave *App::autosave() const
+{
+    return m_autosave;
+}
+
+inline RedrawScheduler *App::redrawScheduler() const
+{
+    return m_redrawScheduler;
+}
+
+inline MemoryBudget *App::memoryBudget() const
+{
+    return m_memoryBudget;
+}
+
 inline const App::RefWindowList &App::referenceWindows() const { return m_refWindows; }
 
 inline const ReferenceCollection *App::referenceItems() const
@@ -196,6 +223,11 @@ inline bool App::hasUnsavedChanges() const
     return m_hasUnsavedChanges;
 }
 
+inline qint64 App::changeCount() const
+{
+    return m_changeCount;
+}
+
 inline bool App::allRefWindowsVisible() const
 {
     return m_allRefWindowsVisible;
@@ -0,0 +1,270 @@
+#include "autosave.h"
+
+#include <algorithm>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QLockFile>
+#include <QtCore/QPromise>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+#include <QtCore/QTimer>
+
+#include "app.h"
+#include "preferences.h"
+#include "reference_image.h"
+#include "saving.h"
+#include "utils/zip_file.h"
+
+namespace
+{
+    const int slotCount = 2;
+    // Recovery files are named autosave_<owner>_<slot>.ghr where owner is the process ID of the instance that
+    // wrote them. The owner holds the lock file autosave_<owner>.lock while it's running.
+    const char *const recoveryFileBaseName = "autosave_";
+    const char *const recoveryFileExt = ".ghr";
+    const char *const lockFileExt = ".lock";
+
+    // Key added to the autosaved session.json for the path of the session file it's an autosave of
+    const char *const autosaveOfKey = "autosaveOf";
+
+    QString currentOwner()
+    {
+        return QString::number(QCoreApplication::applicationPid());
+    }
+
+    QString recoveryFilePath(int slot)
+    {
+        const QDir configDir(Preferences::configDir());
+        return configDir.absoluteFilePath(recoveryFileBaseName + currentOwner() + '_' + QString::number(slot)
+                                          + recoveryFileExt);
+    }
+
+    QString lockFilePath(const QString &owner)
+    {
+        const QDir configDir(Preferences::configDir());
+        return configDir.absoluteFilePath(recoveryFileBaseName + owner + lockFileExt);
+    }
+
+    // The owner of a recovery file. Empty for files written before recovery files had owners.
+    QString recoveryFileOwner(const QFileInfo &recoveryFile)
+    {
+        const QStringList parts = recoveryFile.completeBaseName().split('_');
+        return parts.size() == 3 ? parts[1] : QString();
+    }
+
+    // Locks the recovery files of owner if the instance that wrote them is no longer running. Returns null if
+    // it's still running (or is this instance).
+    std::unique_ptr<QLockFile> lockAbandoned(const QString &owner)
+    {
+        if (owner == currentOwner())
+        {
+            return nullptr;
+        }
+        auto lock = std::make_unique<QLockFile>(lockFilePath(owner.isEmpty() ? "legacy" : owner));
+        lock->setStaleLockTime(0); // Only stale if its process isn't running
+        return lock->tryLock(0) ? std::move(lock) : nullptr;
+    }
+
+    class AutosaveTask : public QRunnable
+    {
+        std::shared_ptr<sessionSaving::SessionSnapshot> m_snapshot;
+        QString m_filepath;
+        QPromise<bool> m_promise;
+
+    public:
+        AutosaveTask(std::shared_ptr<sessionSaving::SessionSnapshot> snapshot, QString filepath)
+            : m_snapshot(std::move(snapshot)),
+              m_filepath(std::move(filepath))
+        {}
+
+        QFuture<bool> future() { return m_promise.future(); }
+
+        void run() override
+        {
+            m_promise.start();
+            m_promise.addResult(sessionSaving::writeSnapshot(*m_snapshot, m_filepath));
+            m_promise.finish();
+        }
+    };
+
+} // namespace
+
+Autosave::Autosave(QObject *parent)
+    : QObject(parent),
+      m_timer(new QTimer(this))
+{
+    QObject::connect(m_timer, &QTimer::timeout, this, &Autosave::autosave);
+
+    // Shows other instances that this instance's recovery files are still in use
+    m_lock = std::make_unique<QLockFile>(lockFilePath(currentOwner()));
+    m_lock->setStaleLockTime(0);
+    if (!m_lock->tryLock(0))
+    {
+        qWarning() << "Unable to lock" << lockFilePath(currentOwner()) << "Error:" << m_lock->error();
+    }
+
+    App *app = App::ghostRefInstance();
+    setInterval(app->preferences()->getInt(Preferences::AutosaveIntervalMins));
+    QObject::connect(app, &App::preferencesReplaced, this,
+                     [this](Preferences *prefs) { setInterval(prefs->getInt(Preferences::AutosaveIntervalMins)); });
+}
+
+Autosave::~Autosave()
+{
+    m_pendingSave.waitForFinished();
+    // Its continuation won't run anymore
+    if (m_pendingSaveDiscards != m_discards)
+    {
+        QFile::remove(m_pendingSaveFile);
+    }
+}
+
+QStringList Autosave::recoveryFiles()
+{
+    const QDir configDir(Preferences::configDir());
+    const QString pattern = recoveryFileBaseName + QString("*") + recoveryFileExt;
+
+    QList<QFileInfo> files;
+    for (const QFileInfo &fileInfo : configDir.entryInfoList({pattern}, QDir::Files))
+    {
+        if (lockAbandoned(recoveryFileOwner(fileInfo)))
+        {
+            files.push_back(fileInfo);
+        }
+    }
+    std::ranges::sort(files, [](const QFileInfo &a, const QFileInfo &b)
+                      { return a.lastModified() > b.lastModified(); });
+
+    QStringList paths;
+    for (const auto &fileInfo : files)
+    {
+        paths.push_back(fileInfo.absoluteFilePath());
+    }
+    return paths;
+}
+
+QString Autosave::originalSessionFile(const QString &recoveryFile)
+{
+    utils::ZipFileReader zipReader;
+    if (!zipReader.open(recoveryFile))
+    {
+        return {};
+    }
+    const QJsonDocument json = QJsonDocument::fromJson(zipReader.getFile("session.json"));
+    return json.object()[autosaveOfKey].toString();
+}
+
+void Autosave::removeRecoveryFiles()
+{
+    for (const QString &filepath : recoveryFiles())
+    {
+        QFile::remove(filepath);
+    }
+}
+
+void Autosave::setInterval(int minutes)
+{
+    if (minutes > 0)
+    {
+        m_timer->start(minutes * 60 * 1000);
+    }
+    else
+    {
+        m_timer->stop();
+    }
+}
+
+void Autosave::autosave()
+{
+    const App *app = App::ghostRefInstance();
+    const qint64 changeCount = app->changeCount();
+    if (isSaving() || !app->hasUnsavedChanges() || changeCount == m_autosavedChangeCount)
+    {
+        return;
+    }
+
+    // Images are compressed by the task instead of on the GUI thread
+    auto snapshot = std::make_shared<sessionSaving::SessionSnapshot>(sessionSaving::takeSnapshot(false));
+    snapshot->json[autosaveOfKey] = app->saveFilePath();
+
+    // Alternate between the recovery files so the last one is kept if this save fails
+    const QString filepath = recoveryFilePath(m_nextSlot);
+    m_nextSlot = (m_nextSlot + 1) % slotCount;
+
+    auto *task = new AutosaveTask(snapshot, filepath);
+    m_pendingSave = task->future();
+    m_pendingSaveFile = filepath;
+    m_pendingSaveDiscards = m_discards;
+    m_pendingSave.then(this, [this, snapshot, filepath, changeCount, discards = m_discards](bool success) {
+        if (discards != m_discards)
+        {
+            // The recovery files were discarded while it was saving
+            QFile::remove(filepath);
+            return;
+        }
+        if (!success)
+        {
+            qWarning() << "Autosave to" << filepath << "failed";
+            return;
+        }
+        m_ownsRecoveryFiles = true;
+        m_autosavedChangeCount = changeCount;
+
+        // Keep the images compressed by the task so they aren't compressed again when saving
+        for (const auto &image : snapshot->images)
+        {
+            const ReferenceImageSP refItem = image.refItem.toStrongRef();
+            if (refItem && refItem->compressedImage().isEmpty() && !image.compressedData.isEmpty()
+                && refItem->baseImage().cacheKey() == image.image.cacheKey())
+            {
+                refItem->setCompressedImage(image.compressedData);
+            }
+        }
+    });
+
+    QThreadPool::globalInstance()->start(task);
+}
+
+bool Autosave::isSaving() const
+{
+    return !m_pendingSave.isFinished();
+}
+
+void Autosave::adoptRecoveryFiles()
+{
+    m_adoptedFiles = recoveryFiles();
+
+    // Stops other instances offering them while they're adopted
+    for (const QString &filepath : m_adoptedFiles)
+    {
+        if (std::unique_ptr<QLockFile> lock = lockAbandoned(recoveryFileOwner(QFileInfo(filepath))))
+        {
+            m_adoptedLocks.push_back(std::move(lock));
+        }
+    }
+}
+
+void Autosave::discardRecoveryFiles()
+{
+    ++m_discards;
+    m_autosavedChangeCount = -1;
+    if (m_ownsRecoveryFiles)
+    {
+        for (int slot = 0; slot < slotCount; ++slot)
+        {
+            QFile::remove(recoveryFilePath(slot));
+        }
+        m_ownsRecoveryFiles = false;
+    }
+
+    for (const QString &filepath : m_adoptedFiles)
+    {
+        QFile::remove(filepath);
+    }
+    m_adoptedFiles.clear();
+    m_adoptedLocks.clear();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <QtCore/QFuture>
+#include <QtCore/QObject>
+#include <QtCore/QStringList>
+
+class QLockFile;
+class QTimer;
+
+// Periodically saves the session to a recovery file so that unsaved changes aren't lost if the
+// application crashes. The session is snapshotted on the GUI thread then compressed and written in
+// the global thread pool. Two recovery files are used in turn so the previous one is still available
+// if writing the newest fails. Each instance has its own recovery files and holds a lock file while
+// it's running, so only the files of instances that are no longer running are offered for recovery.
+class Autosave : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(Autosave)
+
+    QTimer *m_timer;
+    QFuture<bool> m_pendingSave;
+    QString m_pendingSaveFile;
+    // Number of times discardRecoveryFiles was called. A save that was in progress when they were discarded
+    // removes its file once it's finished instead of waiting for it.
+    int m_discards = 0;
+    int m_pendingSaveDiscards = 0;
+    // App::changeCount when the last successful autosave was taken. -1 if the recovery files were discarded
+    // since.
+    qint64 m_autosavedChangeCount = -1;
+    int m_nextSlot = 0;
+    bool m_ownsRecoveryFiles = false;
+    std::unique_ptr<QLockFile> m_lock;
+    // Recovery files of a previous instance that were restored and the locks that stop other instances
+    // offering them
+    QStringList m_adoptedFiles;
+    std::vector<std::unique_ptr<QLockFile>> m_adoptedLocks;
+
+public:
+    explicit Autosave(QObject *parent = nullptr);
+    ~Autosave() override;
+
+    // Recovery files left by instances that are no longer running, newest first. If any exist then
+    // those instances didn't exit cleanly.
+    static QStringList recoveryFiles();
+    // The path of the session file that recoveryFile is an autosave of. Empty if the session had not
+    // been saved.
+    static QString originalSessionFile(const QString &recoveryFile);
+    // Removes the files returned by recoveryFiles
+    static void removeRecoveryFiles();
+
+    // Minutes between autosaves. 0 disables autosave.
+    void setInterval(int minutes);
+
+    // Starts saving a snapshot of the session if there are unsaved changes that haven't been autosaved and a
+    // save isn't in progress.
+    void autosave();
+    bool isSaving() const;
+
+    // Makes discardRecoveryFiles also remove the recovery files left by previous instances. Used after
+    // they have been restored.
+    void adoptRecoveryFiles();
+
+    // Removes the recovery files written by this instance. A save in progress isn't waited for but removes its
+    // file once it has finished. Called when the session is saved or closed normally.
+    void discardRecoveryFiles();
+};
@@ -0,0 +1,22 @@
+#include <benchmark/benchmark.h>
+
+#include "../app.h"
+#include "../preferences.h"
+
+int main(int argc, char *argv[])
+{
+    // Some benchmarks need an App (e.g. for image plugins and preferences)
+    Preferences prefs;
+    prefs.setBool(Preferences::GlobalHotkeysEnabled, false);
+    prefs.setInt(Preferences::AutosaveIntervalMins, 0);
+    const App app(argc, argv, App::ApplicationFlags, &prefs);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
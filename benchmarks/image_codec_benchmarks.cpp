@@ -0,0 +1,105 @@
+#include <benchmark/benchmark.h>
+
+#include <QtCore/QRandomGenerator>
+#include <QtGui/QImage>
+#include <QtGui/QLinearGradient>
+#include <QtGui/QPainter>
+
+#include "../utils/image.h"
+
+namespace
+{
+    // A synthetic 1920x1080 screenshot. Mostly flat UI colours and text with a gradient and a
+    // photographic (noisy) area, similar to the screenshots usually pasted as references.
+    const QImage &screenshot()
+    {
+        static const QImage image = []()
+        {
+            QImage img(1920, 1080, QImage::Format_ARGB32_Premultiplied);
+            img.fill(QColor(45, 45, 48));
+
+            QPainter painter(&img);
+            painter.fillRect(0, 0, 1920, 40, QColor(30, 30, 30));
+            painter.fillRect(0, 40, 300, 1040, QColor(37, 37, 38));
+
+            QLinearGradient gradient(1500, 0, 1920, 0);
+            gradient.setColorAt(0, QColor(20, 60, 120));
+            gradient.setColorAt(1, QColor(200, 120, 40));
+            painter.fillRect(1500, 40, 420, 1040, gradient);
+
+            painter.setPen(QColor(220, 220, 220));
+            for (int y = 60; y < 1060; y += 20)
+            {
+                painter.drawText(10, y, "Reference layer name.png");
+                painter.drawText(320, y, "The quick brown fox jumps over the lazy dog 0123456789");
+            }
+            painter.end();
+
+            // Photo-like area
+            QRandomGenerator rng(42);
+            for (int y = 300; y < 800; y++)
+            {
+                auto *line = reinterpret_cast<QRgb *>(img.scanLine(y));
+                for (int x = 800; x < 1400; x++)
+                {
+                    const int noise = static_cast<int>(rng.bounded(32));
+                    line[x] = qRgb(100 + noise + (x - 800) / 6, 80 + noise + (y - 300) / 5, 60 + noise);
+                }
+            }
+            return img;
+        }();
+        return image;
+    }
+
+    void encodeImage(benchmark::State &state, const utils::ImageCodec &codec)
+    {
+        if (!utils::canEncodeImageFormat(codec.format))
+        {
+            state.SkipWithError("No image plugin for format");
+            return;
+        }
+
+        const QImage &image = screenshot();
+        QByteArray encoded;
+        for (auto _ : state)
+        {
+            encoded = utils::encodeImage(image, codec);
+            benchmark::DoNotOptimize(encoded);
+        }
+        state.counters["size_KB"] = static_cast<double>(encoded.size()) / 1024.;
+        state.SetBytesProcessed(state.iterations() * image.sizeInBytes());
+    }
+
+    void decodeImage(benchmark::State &state, const utils::ImageCodec &codec)
+    {
+        if (!utils::canEncodeImageFormat(codec.format))
+        {
+            state.SkipWithError("No image plugin for format");
+            return;
+        }
+
+        const QByteArray encoded = utils::encodeImage(screenshot(), codec);
+        for (auto _ : state)
+        {
+            QImage image;
+            image.loadFromData(encoded);
+            benchmark::DoNotOptimize(image);
+        }
+        state.counters["size_KB"] = static_cast<double>(encoded.size()) / 1024.;
+        state.SetBytesProcessed(state.iterations() * screenshot().sizeInBytes());
+    }
+
+} // namespace
+
+// N.B. The codec argument needs parentheses around any braces so its commas aren't split by the macro
+#define CODEC_BENCHMARKS(name, codec)                                           \
+    BENCHMARK_CAPTURE(encodeImage, name, codec)->Unit(benchmark::kMillisecond); \
+    BENCHMARK_CAPTURE(decodeImage, name, codec)->Unit(benchmark::kMillisecond);
+
+CODEC_BENCHMARKS(png_default, utils::ImageCodec({"png", -1}))
+CODEC_BENCHMARKS(png_level0, utils::ImageCodec({"png", utils::pngQualityForLevel(0)}))
+CODEC_BENCHMARKS(png_level1, utils::ImageCodec({"png", utils::pngQualityForLevel(1)}))
+CODEC_BENCHMARKS(png_level6, utils::ImageCodec({"png", utils::pngQualityForLevel(6)}))
+CODEC_BENCHMARKS(png_level9, utils::ImageCodec({"png", utils::pngQualityForLevel(9)}))
+CODEC_BENCHMARKS(webp_lossless, utils::ImageCodec({"webp", 100}))
+CODEC_BENCHMARKS(qoi, utils::ImageCodec({"qoi", -1}))
@@ -0,0 +1,54 @@
+#include <benchmark/benchmark.h>
+
+#include <QtGui/QImage>
+
+#include "../utils/image.h"
+
+namespace
+{
+    using utils::SimdLevel;
+
+    QImage gradientImage(QSize size)
+    {
+        QImage image(size, QImage::Format_ARGB32);
+        for (int y = 0; y < image.height(); y++)
+        {
+            auto *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < image.width(); x++)
+            {
+                line[x] = qRgba(x % 256, y % 256, (x ^ y) % 256, 255);
+            }
+        }
+        return image;
+    }
+
+    void reduceSaturation(benchmark::State &state, SimdLevel simdLevel, QSize size)
+    {
+        if (!utils::isSimdLevelSupported(simdLevel))
+        {
+            state.SkipWithError("Instruction set not supported");
+            return;
+        }
+
+        QImage image = gradientImage(size);
+        for (auto _ : state)
+        {
+            utils::reduceSaturation(image, 0.5, simdLevel);
+            benchmark::DoNotOptimize(image.constBits());
+        }
+        state.SetBytesProcessed(state.iterations() * image.sizeInBytes());
+    }
+
+} // namespace
+
+// 4K and 8K images for each instruction set. Unsupported instruction sets are skipped.
+#define SATURATION_BENCHMARKS(name, simdLevel)                                       \
+    BENCHMARK_CAPTURE(reduceSaturation, name##_4k, simdLevel, QSize(3840, 2160))     \
+        ->Unit(benchmark::kMillisecond);                                             \
+    BENCHMARK_CAPTURE(reduceSaturation, name##_8k, simdLevel, QSize(7680, 4320))     \
+        ->Unit(benchmark::kMillisecond);
+
+SATURATION_BENCHMARKS(scalar, SimdLevel::Scalar)
+SATURATION_BENCHMARKS(sse2, SimdLevel::SSE2)
+SATURATION_BENCHMARKS(avx2, SimdLevel::AVX2)
+SATURATION_BENCHMARKS(neon, SimdLevel::NEON)
@@ -0,0 +1,83 @@
+#include <benchmark/benchmark.h>
+
+#include <QtGui/QImage>
+
+#include "../app.h"
+#include "../preferences.h"
+#include "../reference_loading.h"
+#include "../undo_stack.h"
+#include "../widgets/reference_window.h"
+
+namespace
+{
+    // Creates windowCount windows that each show a small reference
+    void createSession(int windowCount)
+    {
+        App *app = App::ghostRefInstance();
+        QImage image(64, 64, QImage::Format_RGB32);
+        image.fill(Qt::gray);
+
+        for (int i = 0; i < windowCount; i++)
+        {
+            ReferenceWindow *refWindow = app->newReferenceWindow();
+            refWindow->addReference(refLoad::fromImage(image));
+            refWindow->move(i * 10, i * 10);
+        }
+    }
+
+    // Pushes a global undo step before moving one window by a pixel, like dragging a window does
+    void pushGlobalUndo(benchmark::State &state)
+    {
+        App *app = App::ghostRefInstance();
+        app->newSession(true);
+        createSession(static_cast<int>(state.range(0)));
+
+        ReferenceWindow *refWindow = app->referenceWindows().first();
+        int x = 0;
+        for (auto _ : state)
+        {
+            app->undoStack()->pushGlobalUndo();
+            refWindow->move(++x % 1000, 0);
+        }
+        state.SetItemsProcessed(state.iterations());
+
+        app->newSession(true);
+    }
+
+    // Pushes stepCount window steps into a full undo history then undoes and redoes every step that's kept.
+    // The window is moved and resized before each step so every step keeps a delta (unchanged steps are
+    // reduced to nothing by UndoStep::diffAgainst).
+    void pushUndoSteps(benchmark::State &state)
+    {
+        const int maxSteps = 1024;
+        const qint64 stepCount = state.range(0);
+
+        App *app = App::ghostRefInstance();
+        app->newSession(true);
+        app->preferences()->setInt(Preferences::UndoMaxSteps, maxSteps);
+        createSession(1);
+
+        ReferenceWindow *refWindow = app->referenceWindows().first();
+        UndoStack *undoStack = app->undoStack();
+        for (auto _ : state)
+        {
+            for (qint64 i = 0; i < stepCount; i++)
+            {
+                undoStack->pushRefWindow(refWindow);
+                refWindow->move(static_cast<int>(i % 1000), 0);
+                refWindow->resize(200 + static_cast<int>(i % 100), 200);
+            }
+            while (undoStack->undo()) {}
+            while (undoStack->redo()) {}
+        }
+        state.SetItemsProcessed(state.iterations() * stepCount);
+        state.counters["undoSteps"] = static_cast<double>(undoStack->undoCount());
+        state.counters["undoMemoryKB"] = static_cast<double>(undoStack->memoryUsage()) / 1024;
+
+        app->newSession(true);
+    }
+
+} // namespace
+
+BENCHMARK(pushGlobalUndo)->Arg(10)->Arg(100)->Unit(benchmark::kMicrosecond);
+BENCHMARK(pushUndoSteps)->Arg(100000)->Unit(benchmark::kMillisecond);
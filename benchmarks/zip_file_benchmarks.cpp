@@ -0,0 +1,63 @@
+#include <benchmark/benchmark.h>
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+
+#include "../utils/zip_file.h"
+
+namespace
+{
+    // Entry names like the images of a session with count references
+    QList<QString> entryNames(qsizetype count)
+    {
+        QList<QString> names;
+        names.reserve(count);
+        for (qsizetype i = 0; i < count; i++)
+        {
+            names.push_back(QString("images/Reference %1.png").arg(i));
+        }
+        return names;
+    }
+
+    // Adds every entry then looks each one up, as building and loading a session does
+    void zipFileAddAndGet(benchmark::State &state)
+    {
+        const QList<QString> names = entryNames(state.range(0));
+        const QByteArray data(64, 'x');
+
+        for (auto _ : state)
+        {
+            utils::ZipFile zipFile;
+            for (const QString &name : names)
+            {
+                zipFile.addFile(name, data);
+            }
+            for (const QString &name : names)
+            {
+                benchmark::DoNotOptimize(zipFile.getFile(name).constData());
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+    void zipFileFromBuffer(benchmark::State &state)
+    {
+        utils::ZipFile source;
+        for (const QString &name : entryNames(state.range(0)))
+        {
+            source.addFile(name, QByteArray(64, 'x'));
+        }
+        QByteArray buffer = source.toBuffer();
+
+        for (auto _ : state)
+        {
+            const utils::ZipFile zipFile = utils::ZipFile::fromBuffer(buffer);
+            benchmark::DoNotOptimize(zipFile.isEmpty());
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+
+} // namespace
+
+BENCHMARK(zipFileAddAndGet)->Arg(5000)->Unit(benchmark::kMillisecond);
+BENCHMARK(zipFileFromBuffer)->Arg(5000)->Unit(benchmark::kMillisecond);
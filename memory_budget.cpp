@@ -0,0 +1,153 @@
+#include "memory_budget.h"
+
+#include <algorithm>
+
+#include <QtCore/QDebug>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
+
+#include "app.h"
+#include "preferences.h"
+#include "redraw_scheduler.h"
+#include "reference_collection.h"
+#include "reference_image.h"
+#include "widgets/reference_window.h"
+
+namespace
+{
+    // Lets a burst of changes (e.g. loading a session) settle before checking
+    const int checkDelayMs = 500;
+} // namespace
+
+MemoryBudget::MemoryBudget(QObject *parent)
+    : QObject(parent),
+      m_timer(new QTimer(this))
+{
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(checkDelayMs);
+    QObject::connect(m_timer, &QTimer::timeout, this, &MemoryBudget::check);
+
+    App *app = App::ghostRefInstance();
+    setBudgetMB(app->preferences()->getInt(Preferences::ImageMemoryBudgetMB));
+    QObject::connect(app, &App::preferencesReplaced, this,
+                     [this](Preferences *prefs) { setBudgetMB(prefs->getInt(Preferences::ImageMemoryBudgetMB)); });
+
+    // References can only be evicted once they're hidden
+    QObject::connect(app, &App::referenceWindowAdded, this, &MemoryBudget::onReferenceWindowAdded);
+    QObject::connect(app, &App::allRefWindowsVisibleChanged, this, &MemoryBudget::scheduleCheck);
+}
+
+void MemoryBudget::setBudgetMB(int megabytes)
+{
+    m_budget = static_cast<qint64>(std::max(megabytes, 0)) * 1024 * 1024;
+    scheduleCheck();
+}
+
+qint64 MemoryBudget::decodedBytes(const QList<ReferenceImageSP> &references)
+{
+    QSet<qint64> counted;
+    qint64 total = 0;
+    for (const auto &refItem : references)
+    {
+        total += refItem->imagePyramidBytes();
+        const QImage &image = refItem->baseImage();
+        if (!image.isNull() && !counted.contains(image.cacheKey()))
+        {
+            counted.insert(image.cacheKey());
+            total += image.sizeInBytes();
+        }
+    }
+    return total;
+}
+
+void MemoryBudget::scheduleCheck()
+{
+    if (!m_timer->isActive())
+    {
+        m_timer->start();
+    }
+}
+
+void MemoryBudget::check()
+{
+    const QList<ReferenceImageSP> references = App::ghostRefInstance()->referenceItems()->references();
+
+    // Evicting the image a linked copy takes its data from wouldn't free anything
+    QSet<const ReferenceImage *> linkedSources;
+    for (const auto &refItem : references)
+    {
+        if (const ReferenceImageSP source = refItem->linkedCopyOf())
+        {
+            linkedSources.insert(source.get());
+        }
+    }
+
+    QSet<const ReferenceImage *> alive;
+    QList<ReferenceImageSP> candidates;
+    for (const auto &refItem : references)
+    {
+        alive.insert(refItem.get());
+        if (RedrawScheduler::priority(refItem) != RedrawScheduler::HiddenPriority)
+        {
+            m_lastVisible.insert(refItem.get(), ++m_visibleCount);
+        }
+        else if (refItem->canEvictBaseImage() && !linkedSources.contains(refItem.get()))
+        {
+            candidates.push_back(refItem);
+        }
+    }
+    for (auto it = m_lastVisible.begin(); it != m_lastVisible.end();)
+    {
+        it = alive.contains(it.key()) ? std::next(it) : m_lastVisible.erase(it);
+    }
+
+    qint64 used = decodedBytes(references);
+    if (m_budget <= 0 || used <= m_budget)
+    {
+        return;
+    }
+
+    // The memory of an image is only freed once every reference that shares it has been evicted
+    QHash<qint64, int> shareCounts;
+    for (const auto &refItem : references)
+    {
+        if (!refItem->baseImage().isNull())
+        {
+            ++shareCounts[refItem->baseImage().cacheKey()];
+        }
+    }
+
+    std::ranges::sort(candidates, [this](const ReferenceImageSP &a, const ReferenceImageSP &b) {
+        return m_lastVisible.value(a.get()) < m_lastVisible.value(b.get());
+    });
+
+    for (const auto &refItem : candidates)
+    {
+        if (used <= m_budget)
+        {
+            break;
+        }
+        const qint64 key = refItem->baseImage().cacheKey();
+        const qint64 size = refItem->baseImage().sizeInBytes();
+        const qint64 pyramidSize = refItem->imagePyramidBytes();
+        if (refItem->evictBaseImage())
+        {
+            used -= pyramidSize;
+            if (--shareCounts[key] == 0)
+            {
+                used -= size;
+            }
+        }
+    }
+
+    if (used > m_budget)
+    {
+        qWarning() << "Decoded images use" << used / (1024 * 1024) << "MB after evicting hidden references";
+    }
+}
+
+void MemoryBudget::onReferenceWindowAdded(ReferenceWindow *refWindow)
+{
+    QObject::connect(refWindow, &ReferenceWindow::activeImageChanged, this, &MemoryBudget::scheduleCheck);
+    QObject::connect(refWindow, &ReferenceWindow::ghostRefHiddenChanged, this, &MemoryBudget::scheduleCheck);
+}
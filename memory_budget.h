@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+
+#include "types.h"
+
+class QTimer;
+
+// Keeps the memory used by decoded base images under the ImageMemoryBudgetMB preference. When it's exceeded
+// the base images of references that aren't visible are evicted, least recently visible first. Evicted
+// images are decoded again from their compressed data when they're next shown (see
+// ReferenceImage::restoreBaseImage).
+class MemoryBudget : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(MemoryBudget)
+
+    QTimer *m_timer;
+    qint64 m_budget = 0; // In bytes. 0 for no limit.
+
+    // When each reference was last seen visible. Larger values are more recent.
+    QHash<const ReferenceImage *, quint64> m_lastVisible;
+    quint64 m_visibleCount = 0;
+
+public:
+    explicit MemoryBudget(QObject *parent = nullptr);
+
+    // 0 for no limit
+    void setBudgetMB(int megabytes);
+    qint64 budget() const;
+
+    // Bytes used by the decoded base images of references and the image pyramids rendered from them. Images
+    // shared by several references are only counted once.
+    static qint64 decodedBytes(const QList<ReferenceImageSP> &references);
+
+    // Checks the budget once control returns to the event loop. Calls made before then are merged.
+    void scheduleCheck();
+    // Evicts base images of hidden references until their total size is within the budget
+    void check();
+
+private:
+    void onReferenceWindowAdded(ReferenceWindow *refWindow);
+};
+
+inline qint64 MemoryBudget::budget() const
+{
+    return m_budget;
+}
@@ -24,6 +24,13 @@ namespace
 
     const char *const configName = "ghost_reference_config.json";
 
+    // The value of each item is the format name used by QImageWriter
+    const QVector<PrefEnumItem> storedImageFormats = {
+        {"png", "PNG", "png"},
+        {"webp", "WebP (lossless)", "webp"},
+        {"qoi", "QOI", "qoi"},
+    };
+
     QDir getConfigDir()
     {
         return {Preferences::configDir()};
@@ -114,6 +121,7 @@ namespace
         }
         bool isCompatible(const QMetaType &type) const { return QMetaType::canConvert(QMetaType(m_type), type); }
         bool isEnum() const { return m_enumValues != nullptr; }
+        int enumCount() const { return isEnum() ? static_cast<int>(m_enumValues->length()) : 0; }
         bool isValid() const
         {
             return m_type != QMetaType::UnknownType;
@@ -132,10 +140,25 @@ namespace
             {AskSaveBeforeClosing,
              {"askSaveBeforeClosing", BoolType, true, "Ask to save when exiting",
               "Ask to save any unsaved changes when closing the application."}},
+            {AutosaveIntervalMins,
+             {"autosaveIntervalMins",
+              5,
+              "Autosave interval (minutes)",
+              "How often unsaved changes are saved to a recovery file in the background. "
+              "The recovery file is restored the next time the application starts if it crashes. "
+              "0 to disable autosave.",
+              {0, 120}}},
             {GhostModeOpacity, {"ghostModeOpacity", 0.5, "Ghost Mode Opacity", "", {0., 1.}}},
             {GlobalHotkeysEnabled,
              {"globalHotkeysEnabled", true, "Global Hotkeys",
               "Enable global hotkeys (hotkeys that work event when another application is focused)."}},
+            {ImageMemoryBudgetMB,
+             {"imageMemoryBudgetMB",
+              4096,
+              "Image memory budget (MB)",
+              "The memory that decoded images may use. When it's exceeded the images of hidden references are "
+              "unloaded and decoded again when they are shown. 0 for no limit.",
+              {0, 1024 * 1024}}},
             {LocalFilesLink,
              {"localFilesLink", BoolType, false, "Link Local Files by Default",
               "Default to storing local files as links when saving the session instead of creating copies."}},
@@ -148,6 +171,44 @@ namespace
             {OverrideKeyAlt, {"overrideKeyAlt", BoolType, true, "Alt", ""}},
             {OverrideKeyCtrl, {"overrideKeyCtrl", BoolType, false, "Ctrl", ""}},
             {OverrideKeyShift, {"overrideKeyShift", BoolType, false, "Shift", ""}},
+            {PaintTimeEffects,
+             {"paintTimeEffects", BoolType, false, "Fast Flip and Saturation",
+              "Flip and desaturate images when they are drawn instead of redrawing them. Much faster for large "
+              "images but the saturation of partially transparent pixels is approximate."}},
+            {PrefetchTabs,
+             {"prefetchTabs",
+              1,
+              "Prefetch tabs",
+              "The number of tabs either side of the active tab whose images are decoded in the background so "
+              "switching to them is quick. The images in other tabs are decoded when they are first shown.",
+              {0, 16}}},
+            {RedrawThreads,
+             {"redrawThreads",
+              0,
+              "Redraw threads",
+              "The number of threads used to redraw images after they are zoomed, cropped or changed. "
+              "0 to use one per CPU core.",
+              {0, 64}}},
+            {StoredImageCompression,
+             {"storedImageCompression",
+              1,
+              "Image compression level",
+              "How much to compress images stored in session files (0 fastest - 9 smallest). "
+              "Only used by PNG.",
+              {0, 9}}},
+            {StoredImageFormat,
+             {"storedImageFormat", "png", "Stored image format",
+              "The lossless format used to store images that aren't from a file (e.g. pasted images) in "
+              "session files. PNG is used if the format isn't supported. WebP and QOI need the matching "
+              "Qt image plugins to load the session.",
+              &storedImageFormats}},
+            {UndoMaxMemoryMB,
+             {"undoMaxMemoryMB",
+              512,
+              "Max undo memory (MB)",
+              "The memory that undo steps may use. The oldest steps are removed when it's exceeded. 0 for no "
+              "limit.",
+              {0, 1024 * 1024}}},
             {UndoMaxSteps,
              {"undoMaxSteps",
               32,
@@ -510,6 +571,27 @@ const PrefEnumItem &Preferences::getEnumItem(Keys key, int idx)
     return g_nullEnumPrefItem;
 }
 
+int Preferences::getEnumCount(Keys key)
+{
+    const auto it = prefProperties().find(key);
+    return (it != prefProperties().end()) ? it->enumCount() : 0;
+}
+
+const PrefEnumItem &Preferences::getEnumItem(Keys key) const
+{
+    const QString identifier = getString(key);
+    const int count = getEnumCount(key);
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (const PrefEnumItem &item = getEnumItem(key, i); item.identifier == identifier)
+        {
+            return item;
+        }
+    }
+    return getEnumItem(key, 0);
+}
+
 PrefFloatRange Preferences::getFloatRange(Keys key)
 {
     const auto it = prefProperties().find(key);
@@ -40,14 +40,22 @@ public:
         AllowInternet,
         AnimateToolbarCollapse,
         AskSaveBeforeClosing,
+        AutosaveIntervalMins,
         GhostModeOpacity,
         GlobalHotkeysEnabled,
+        ImageMemoryBudgetMB,
         LocalFilesLink,
         LocalFilesStoreMaxMB,
         LoggingEnabled,
         OverrideKeyAlt,
         OverrideKeyCtrl,
         OverrideKeyShift,
+        PaintTimeEffects,
+        PrefetchTabs,
+        RedrawThreads,
+        StoredImageCompression,
+        StoredImageFormat,
+        UndoMaxMemoryMB,
         UndoMaxSteps,
     };
 
@@ -70,6 +78,7 @@ public:
     static const QString &getDisplayName(Keys key);
     static const QString &getDescription(Keys key);
     static const PrefEnumItem &getEnumItem(Keys key, int idx);
+    static int getEnumCount(Keys key);
     static PrefFloatRange getFloatRange(Keys key);
     static PrefIntRange getIntRange(Keys key);
     static QMetaType::Type getType(Keys key);
@@ -79,6 +88,10 @@ public:
 
     QVariant getVariant(Keys key) const;
 
+    // Returns the item of an enum preference matching its current value. Returns the first item if the
+    // value is invalid.
+    const PrefEnumItem &getEnumItem(Keys key) const;
+
     void set(Keys key, const QVariant &value);
 
 #define PREFS_GET(name, type) \
@@ -0,0 +1,151 @@
+#include "redraw_scheduler.h"
+
+#include <algorithm>
+
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+
+#include "app.h"
+#include "preferences.h"
+#include "reference_image.h"
+#include "widgets/reference_window.h"
+
+class RedrawScheduler::RedrawJob : public QRunnable
+{
+    RedrawScheduler *m_scheduler;
+    ReferenceImageSP m_image;
+
+public:
+    RedrawJob(RedrawScheduler *scheduler, ReferenceImageSP image)
+        : m_scheduler(scheduler),
+          m_image(std::move(image))
+    {}
+
+    void run() override
+    {
+        redrawImage(*m_image);
+
+        // The image is released on the GUI thread after the scheduler has been notified. The call is
+        // dropped if the scheduler has been deleted. It's moved into the call so the job (which is deleted
+        // on this thread) doesn't keep a reference.
+        QMetaObject::invokeMethod(
+            m_scheduler,
+            [scheduler = m_scheduler, image = std::move(m_image)]() { scheduler->onRedrawFinished(image); },
+            Qt::QueuedConnection);
+    }
+};
+
+RedrawScheduler::RedrawScheduler(QObject *parent)
+    : QObject(parent)
+{
+    App *app = App::ghostRefInstance();
+    setWorkerCount(app->preferences()->getInt(Preferences::RedrawThreads));
+    QObject::connect(app, &App::preferencesReplaced, this,
+                     [this](Preferences *prefs) { setWorkerCount(prefs->getInt(Preferences::RedrawThreads)); });
+}
+
+RedrawScheduler::~RedrawScheduler()
+{
+    m_threadPool.waitForDone();
+}
+
+void RedrawScheduler::setWorkerCount(int count)
+{
+    m_threadPool.setMaxThreadCount(count > 0 ? count : QThread::idealThreadCount());
+    dispatch();
+}
+
+int RedrawScheduler::workerCount() const
+{
+    return m_threadPool.maxThreadCount();
+}
+
+void RedrawScheduler::requestRedraw(const ReferenceImageSP &image)
+{
+    if (!image)
+    {
+        return;
+    }
+
+    // If the image is being redrawn then that redraw sees that it's outdated and stops early.
+    // It's redrawn again once it has finished.
+    const bool isPending =
+        std::ranges::any_of(m_pending, [&image](const ReferenceImageWP &pending) { return pending == image; });
+    if (!isPending)
+    {
+        m_pending.push_back(image.toWeakRef());
+    }
+    dispatch();
+}
+
+RedrawScheduler::Priority RedrawScheduler::priority(const ReferenceImageSP &image)
+{
+    // Reference windows are children of the back window so check which one contains the focus widget
+    const QWidget *focusWidget = QApplication::focusWidget();
+
+    Priority result = HiddenPriority;
+    for (const auto &refWindow : App::ghostRefInstance()->referenceWindows())
+    {
+        if (refWindow && refWindow->activeImage() == image && refWindow->isVisible())
+        {
+            if (focusWidget && (refWindow == focusWidget || refWindow->isAncestorOf(focusWidget)))
+            {
+                return FocusedPriority;
+            }
+            result = VisiblePriority;
+        }
+    }
+    return result;
+}
+
+void RedrawScheduler::dispatch()
+{
+    while (m_running.size() < m_threadPool.maxThreadCount() && !m_pending.isEmpty())
+    {
+        // Find the highest priority image that isn't already being redrawn. Earlier requests win ties.
+        qsizetype next = -1;
+        ReferenceImageSP nextImage;
+        Priority nextPriority = HiddenPriority;
+
+        for (qsizetype i = 0; i < m_pending.size();)
+        {
+            const ReferenceImageSP image = m_pending.at(i).toStrongRef();
+            if (!image)
+            {
+                m_pending.removeAt(i); // Deleted while waiting
+                continue;
+            }
+            if (!m_running.contains(image.get()))
+            {
+                const Priority imagePriority = priority(image);
+                if (!nextImage || imagePriority > nextPriority)
+                {
+                    next = i;
+                    nextImage = image;
+                    nextPriority = imagePriority;
+                }
+            }
+            ++i;
+        }
+
+        if (!nextImage)
+        {
+            return; // All the waiting images are already being redrawn
+        }
+
+        m_pending.removeAt(next);
+        m_running.insert(nextImage.get());
+        m_threadPool.start(new RedrawJob(this, nextImage));
+    }
+}
+
+void RedrawScheduler::onRedrawFinished(const ReferenceImageSP &image)
+{
+    m_running.remove(image.get());
+    dispatch();
+}
+
+void RedrawScheduler::redrawImage(ReferenceImage &image)
+{
+    image.redrawImage();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QThreadPool>
+
+#include "types.h"
+
+// Redraws the display images of ReferenceImages in a dedicated thread pool so that redraws don't compete
+// with other work in the global pool. Requests for an image that is already waiting are merged into one
+// redraw. Requesting a redraw of an image that is being redrawn cancels the outdated redraw and queues a
+// new one. Waiting images in the focused window are redrawn first, then those in other visible windows.
+class RedrawScheduler : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY_MOVE(RedrawScheduler)
+
+public:
+    enum Priority
+    {
+        HiddenPriority,
+        VisiblePriority,
+        FocusedPriority,
+    };
+
+private:
+    class RedrawJob;
+
+    QThreadPool m_threadPool;
+    QList<ReferenceImageWP> m_pending; // In the order they were requested
+    QSet<const ReferenceImage *> m_running;
+
+public:
+    explicit RedrawScheduler(QObject *parent = nullptr);
+    ~RedrawScheduler() override;
+
+    // Number of images redrawn at the same time. 0 uses QThread::idealThreadCount.
+    void setWorkerCount(int count);
+    int workerCount() const;
+
+    // Queues a redraw of image. Must be called from the GUI thread.
+    void requestRedraw(const ReferenceImageSP &image);
+
+    static Priority priority(const ReferenceImageSP &image);
+    // True if image's display image is being redrawn by one of the workers
+    bool isRedrawing(const ReferenceImage *image) const;
+
+private:
+    // Starts redraws of the highest priority waiting images while there are free workers
+    void dispatch();
+    void onRedrawFinished(const ReferenceImageSP &image);
+    static void redrawImage(ReferenceImage &image);
+};
+
+inline bool RedrawScheduler::isRedrawing(const ReferenceImage *image) const
+{
+    return m_running.contains(image);
+}
@@ -7,7 +7,6 @@
 #include <QtCore/QString>
 
 #include "reference_image.h"
-#include "reference_loading.h"
 
 // TODO Implement cleaning to remove old null pointers when adding a reference item
 
@@ -76,7 +75,8 @@ void ReferenceCollection::renameReference(ReferenceImage &refItem, const QString
 }
 
 QList<ReferenceImageSP> ReferenceCollection::loadJson(const QJsonObject &json,
-                                                      const QMap<QString, QByteArray> &imageData)
+                                                      const QMap<QString, QByteArray> &imageData,
+                                                      const std::shared_ptr<const void> &imageDataOwner)
 {
     QList<ReferenceImageSP> loadedRefs;
 
@@ -89,17 +89,10 @@ QList<ReferenceImageSP> ReferenceCollection::loadJson(const QJsonObject &json,
             continue;
         }
 
-        const auto imageFound = imageData.find(it.key());
-        RefImageLoaderUP loader;
-        if (imageFound != imageData.end())
-        {
-            loader = std::move(std::make_unique<RefImageLoader>(imageFound.value()));
-        }
-
-        // N.B. Linked (not stored in the .ghr) files will be loaded in refImage->fromJson
-
+        // N.B. Linked (not stored in the .ghr) files will be loaded in refImage->fromJson. Neither is decoded
+        // until the reference is shown.
         ReferenceImageSP refImage = newReferenceImage();
-        refImage->fromJson(jsonObj, std::move(loader));
+        refImage->fromSessionJson(jsonObj, imageData.value(it.key()), imageDataOwner);
         loadedRefs.push_back(std::move(refImage));
     }
     return loadedRefs;
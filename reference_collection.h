@@ -26,7 +26,11 @@ public:
     // with the same name will be renamed.
     void renameReference(ReferenceImage &refItem, const QString &newName, bool force = false);
 
-    QList<ReferenceImageSP> loadJson(const QJsonObject &json, const QMap<QString, QByteArray> &imageData);
+    // imageDataOwner keeps imageData valid if it refers to memory it doesn't own (see
+    // RefImageLoader::fileDataOwner)
+    QList<ReferenceImageSP> loadJson(const QJsonObject &json,
+                                     const QMap<QString, QByteArray> &imageData,
+                                     const std::shared_ptr<const void> &imageDataOwner = {});
     QJsonObject toJson() const;
 
     QList<ReferenceImageSP> references() const;
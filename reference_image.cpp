@@ -1,18 +1,20 @@
 #include "reference_image.h"
 
-#include <QtCore/QBuffer>
+#include <utility>
+
 #include <QtCore/QDebug>
 #include <QtCore/QJsonArray>
 #include <QtCore/QJsonObject>
-#include <QtCore/QThreadPool>
 
 #include <QtGui/QImage>
 #include <QtGui/QPainter>
 
 #include "app.h"
+#include "memory_budget.h"
 #include "preferences.h"
 #include "reference_collection.h"
 #include "reference_loading.h"
+#include "redraw_scheduler.h"
 
 #include "utils/image.h"
 
@@ -24,108 +26,63 @@ namespace
         return *App::ghostRefInstance()->referenceItems();
     }
 
-    QSize smallestSize(const QSize &a, const QSize &b)
-    {
-        return (a.width() * a.height() < b.width() * b.height()) ? a : b;
-    }
-
-    const qreal defaultEpsilon = 1e-3;
-
-    bool nearlyEqual(qreal a, qreal b, qreal epsilon = defaultEpsilon)
+    // Scales rect by scale rounding it to the nearest pixels
+    QRect scaledRect(const QRect &rect, qreal scale)
     {
-        return abs(a - b) <= epsilon;
-    }
-
-} // namespace
-
-/*
-Class in charge of scheduling redraws of a ReferenceImage's displayImage.
-Redraws can be requested using requestRedraw and may be dropped if multiple redraws are
-requested in quick succession. Redraws are performed asynchronously in a thread from the  
-application thread pool.
-*/
-class ReferenceImageRedrawManager
-{
-    Q_DISABLE_COPY_MOVE(ReferenceImageRedrawManager);
-
-public:
-    class RedrawTask : public QRunnable
-    {
-        ReferenceImageWP m_refImage;
-    public:
-        explicit RedrawTask(ReferenceImageWP refImage) : m_refImage(std::move(refImage)) {}
-        explicit RedrawTask(const ReferenceImageSP& refImage) : RedrawTask(refImage.toWeakRef()) {}
-
-        void run() override
+        if (scale == 1.0)
         {
-            const ReferenceImageSP refImageSP = m_refImage.toStrongRef();
-            refImageSP->m_redrawManager->doRedraw();
+            return rect;
         }
-    };
-
-private:
+        return {QPoint(qRound(rect.left() * scale), qRound(rect.top() * scale)),
+                QSize(qRound(rect.width() * scale), qRound(rect.height() * scale))};
+    }
 
-    QPointer<ReferenceImage> m_refImage;
-    std::atomic_flag m_redrawInProgress;
-    std::atomic_flag m_pendingRedraw;
+    // The longest side of the preview image
+    const int previewImageSize = 1024;
 
-    // Perform the redraw. Called by RedrawTask.
-    void doRedraw()
+    // Draws source of image to target flipped by effects then blends grey over it to reduce its saturation
+    void drawWithEffects(QPainter &painter, const QRectF &target, const QImage &image, const QImage &grey,
+                         const QRectF &source, const utils::ImageEffects &effects)
     {
-        if (m_redrawInProgress.test_and_set())
-        {
-            return;
-        }
-
-        const ReferenceImageSP refImage = refImageSP();
-        if (refImage)
+        painter.save();
+        if (effects.flipHorizontal || effects.flipVertical)
         {
-            refImage->redrawImage();
+            painter.translate(target.center());
+            painter.scale(effects.flipHorizontal ? -1. : 1., effects.flipVertical ? -1. : 1.);
+            painter.translate(-target.center());
         }
-        m_redrawInProgress.clear();
+        painter.drawImage(target, image, source);
 
-        // If another redraw was requested while this redraw was in progress
-        // then start another redraw task now.
-        if (m_pendingRedraw.test() && refImage)
+        if (effects.saturation < 1.0 && !grey.isNull())
         {
-            m_pendingRedraw.clear();
-            QThreadPool::globalInstance()->start(new RedrawTask(refImage));
+            // Blending towards the grey copy is the same as utils::reduceSaturation for opaque pixels
+            painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+            painter.setOpacity(painter.opacity() * (1.0 - effects.saturation));
+            painter.drawImage(target, grey, source);
         }
+        painter.restore();
     }
 
-public:
-    explicit ReferenceImageRedrawManager(ReferenceImage* refImage)
-        : m_refImage(refImage) {}
-    ~ReferenceImageRedrawManager() = default;
+    const qreal defaultEpsilon = 1e-3;
 
-    ReferenceImageSP refImageSP() const 
+    bool nearlyEqual(qreal a, qreal b, qreal epsilon = defaultEpsilon)
     {
-        return m_refImage ? getRefCollection().getReferenceImage(m_refImage->name()) : nullptr;
+        return abs(a - b) <= epsilon;
     }
 
-    void requestRedraw()
-    {
-        if (m_refImage.isNull()) { return; }
-
-        // If a redraw is already in progress then the redraw task should only be started
-        // after that redraw has finished.
-        if (m_redrawInProgress.test())
-        {
-            m_pendingRedraw.test_and_set();
-        }
-        else
-        {
-            QThreadPool::globalInstance()->start(new RedrawTask(refImageSP()));
-        }
-    }
-};
+} // namespace
 
 ReferenceImage::ReferenceImage()
     : m_loader(new RefImageLoader()),
-      m_redrawManager(new ReferenceImageRedrawManager(this)),
-      m_savedAsLink(appPrefs()->getBool(Preferences::LocalFilesLink))
+      m_savedAsLink(appPrefs()->getBool(Preferences::LocalFilesLink)),
+      m_paintTimeEffects(appPrefs()->getBool(Preferences::PaintTimeEffects))
 {
-    QObject::connect(this, &ReferenceImage::settingsChanged, this, &ReferenceImage::updateDisplayImage);
+    QObject::connect(App::ghostRefInstance(), &App::preferencesReplaced, this, [this](Preferences *prefs) {
+        setPaintTimeEffects(prefs->getBool(Preferences::PaintTimeEffects));
+    });
+
+    // A newer redraw request makes the redraw in progress outdated
+    m_imagePyramid.setCancelCheck([this]() { return m_displayImageUpdate.test(); });
 }
 
 ReferenceImage::ReferenceImage(RefImageLoaderUP &&loader)
@@ -154,14 +111,21 @@ ReferenceImageSP ReferenceImage::duplicate(bool linked) const
     ReferenceCollection &refCollection = getRefCollection();
     ReferenceImageSP dup = refCollection.newReferenceImage();
 
-    RefImageLoaderUP loader = std::make_unique<RefImageLoader>(m_baseImage);
-    dup->fromJson(toJson(), std::move(loader));
-
     if (linked)
     {
+        // Linked copies share the source's base image so they don't need a loader
+        dup->fromJson(toJson(), nullptr);
         dup->setLinkedCopyOf(getSharedPtr());
+        return dup;
     }
 
+    // Downsampled and evicted images are decoded again at the resolution they're displayed at
+    RefImageLoaderUP loader = m_evicted || isDownsampled()
+                                  ? std::make_unique<RefImageLoader>(m_compressedImage,
+                                                                     DecodeResolution{displayImageScale()},
+                                                                     m_compressedImageOwner, m_compressedImageHash)
+                                  : std::make_unique<RefImageLoader>(m_baseImage);
+    dup->fromJson(toJson(), std::move(loader));
     return dup;
 }
 
@@ -179,9 +143,11 @@ void ReferenceImage::fromJson(const QJsonObject &json, RefImageLoaderUP &&loader
     {
         setLinkedCopyOf(getRefCollection().getReferenceImage(linkedCopyOfName));
     }
-    else if (!m_loader && !filepath().isEmpty())
+    else if (!isLoaded() && !isLoading() && (!m_compressedImage.isEmpty() || !filepath().isEmpty()))
     {
-        setLoader(std::make_unique<RefImageLoader>(filepath()));
+        // Decoded from the compressed image (or the linked file) once it's shown so loading a session doesn't
+        // decode every tab. See restoreBaseImage.
+        m_evicted = true;
     }
 
     setZoom(json["zoom"].toDouble(1.0));
@@ -194,13 +160,31 @@ void ReferenceImage::fromJson(const QJsonObject &json, RefImageLoaderUP &&loader
     const QJsonArray cropArray = json["crop"].toArray();
     if (cropArray.count() == 4)
     {
-        setCropF({cropArray[0].toDouble(), cropArray[1].toDouble(),
-                  cropArray[2].toDouble(), cropArray[3].toDouble()});
+        const QRectF cropF(cropArray[0].toDouble(), cropArray[1].toDouble(),
+                           cropArray[2].toDouble(), cropArray[3].toDouble());
+        if (isLoaded())
+        {
+            setCropF(cropF);
+        }
+        else
+        {
+            // The loader is still running so keep the crop (and zoom) until the base image is set
+            m_crop = cropF;
+            m_cropPending = true;
+        }
     }
 
     updateDisplayImage();
 }
 
+void ReferenceImage::fromSessionJson(const QJsonObject &json,
+                                     const QByteArray &compressedImage,
+                                     const std::shared_ptr<const void> &compressedImageOwner)
+{
+    setCompressedImage(compressedImage, compressedImageOwner);
+    fromJson(json, nullptr);
+}
+
 QJsonObject ReferenceImage::toJson() const
 {
     const QJsonArray cropArray({m_crop.left(), m_crop.top(), m_crop.width(), m_crop.height()});
@@ -235,12 +219,76 @@ void ReferenceImage::applyRenderHints(QPainter &painter) const
 
 void ReferenceImage::updateDisplayImage()
 {
-    if (!m_displayImageUpdate.test_and_set())
+    if (isDownsampled() && displayImageScale() > baseImageScale())
+    {
+        decodeFullImage(); // The proxy is redrawn upscaled until the full image is decoded
+    }
+
+    if (m_displayImageUpdate.test_and_set())
     {
-        m_redrawManager->requestRedraw();
+        return; // Already waiting for a redraw
+    }
+
+    // N.B. Not getSharedPtr as this may be called before the image is added to the collection
+    const ReferenceImageSP refImageSP = getRefCollection().getReferenceImage(name());
+    if (refImageSP == this)
+    {
+        App::ghostRefInstance()->redrawScheduler()->requestRedraw(refImageSP);
+    }
+    else
+    {
+        m_displayImageUpdate.clear();
     }
 }
 
+utils::ImageEffects ReferenceImage::paintEffects() const
+{
+    utils::ImageEffects effects;
+    effects.flipHorizontal = flipHorizontal() != m_displayImageEffects.flipHorizontal;
+    effects.flipVertical = flipVertical() != m_displayImageEffects.flipVertical;
+    if (nearlyEqual(m_displayImageEffects.saturation, 1.0) && !nearlyEqual(saturation(), 1.0))
+    {
+        effects.saturation = saturation();
+    }
+    return effects;
+}
+
+void ReferenceImage::drawDisplayImage(QPainter &painter, const QRectF &target) const
+{
+    const QRect cropRect = crop();
+    const bool containsCrop =
+        !m_displayImage.isNull() && m_displayImageRect.contains(scaledRect(cropRect, m_displayImageScale));
+
+    if (containsCrop && nearlyEqual(m_displayImageScale, displayImageScale()))
+    {
+        drawWithEffects(painter, target, m_displayImage, m_displayImageGrey, displayImageCrop(), paintEffects());
+        return;
+    }
+
+    // The display image is still being redrawn. Draw whatever covers the crop with nearest neighbour filtering
+    // so zooming and resizing don't wait for the redraw. displayImageUpdated repaints it once it's finished.
+    painter.save();
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    if (containsCrop)
+    {
+        drawWithEffects(painter, target, m_displayImage, m_displayImageGrey, displayImageCrop(), paintEffects());
+    }
+    else if (!m_previewImage.isNull() && !m_baseImageSize.isEmpty())
+    {
+        const QTransform toPreview =
+            QTransform::fromScale(m_previewImage.width() / static_cast<qreal>(m_baseImageSize.width()),
+                                  m_previewImage.height() / static_cast<qreal>(m_baseImageSize.height()));
+
+        utils::ImageEffects effects;
+        effects.flipHorizontal = flipHorizontal();
+        effects.flipVertical = flipVertical();
+        effects.saturation = saturation();
+        drawWithEffects(painter, target, m_previewImage, m_previewImageGrey, toPreview.mapRect(cropRect.toRectF()),
+                        effects);
+    }
+    painter.restore();
+}
+
 qreal ReferenceImage::hoverOpacity() const
 {
     return appPrefs()->getFloat(Preferences::GhostModeOpacity);
@@ -271,6 +319,7 @@ void ReferenceImage::reload()
     {
         return;
     }
+    m_redecoding = false;
     setLoader(std::make_unique<RefImageLoader>(QUrl::fromLocalFile(filepath())));
 }
 
@@ -281,12 +330,39 @@ void ReferenceImage::checkHasAlpha()
 
 void ReferenceImage::onLoaderFinished()
 {
+    const bool redecoded = std::exchange(m_redecoding, false) && !m_compressedImage.isEmpty();
     const QImage image = m_loader->image();
+    if (redecoded && image.isNull() && isLoaded())
+    {
+        // Decoding at a higher resolution failed. Keep showing the downsampled image.
+        qWarning() << "Unable to decode" << name() << "at full resolution:" << m_loader->errorMessage();
+        return;
+    }
+    m_evicted = false; // Don't retry decoding if it failed
     if (image != m_baseImage)
     {
-        setBaseImage(image);
+        setBaseImage(image, m_loader->fullSize());
+    }
+    else if (image.isNull())
+    {
+        // Loading failed. Notify widgets so that they can display the error message.
+        emit settingsChanged();
+    }
+
+    // A redecoded image was decoded from the compressed image so keep it (the session file may share it)
+    if (!redecoded)
+    {
+        setCompressedImage(m_loader->fileData(), m_loader->fileDataOwner(), m_loader->fileDataHash());
     }
-    setCompressedImage(m_loader->fileData());
+    else if (m_compressedImageHash.isEmpty())
+    {
+        m_compressedImageHash = m_loader->fileDataHash();
+    }
+}
+
+bool ReferenceImage::isLoading() const
+{
+    return m_loader && !m_loader->finished();
 }
 
 bool ReferenceImage::isValid() const
@@ -306,7 +382,7 @@ void ReferenceImage::setCropF(QRectF value)
     // Ensure there is already a valid crop (needed for clamping)
     if (!m_crop.isValid())
     {
-        m_crop = m_baseImage.rect().toRectF();
+        m_crop = QRectF(QPointF(), m_baseImageSize.toSizeF());
     }
     if (!value.isValid())
     {
@@ -315,16 +391,22 @@ void ReferenceImage::setCropF(QRectF value)
     }
 
     // Clamp the crop to the base image
-    value = value.intersected(m_baseImage.rect());
+    value = value.intersected(QRectF(QPointF(), m_baseImageSize.toSizeF()));
 
     m_crop = value;
 
+    // The display image only contains the tiles around the previous crop
+    if (!displayImageContains(crop()))
+    {
+        updateDisplayImage();
+    }
+
     emit cropChanged(crop());
 }
 
 void ReferenceImage::shiftCropF(QPointF shiftBy)
 {
-    const QRectF imgBounds = m_baseImage.rect().toRectF();
+    const QRectF imgBounds(QPointF(), m_baseImageSize.toSizeF());
     QRectF newCrop = m_crop.translated(shiftBy);
 
     qreal adjustX = 0.;
@@ -356,15 +438,16 @@ void ReferenceImage::shiftCropF(QPointF shiftBy)
 
 QRect ReferenceImage::displayImageCrop() const
 {
-    if (m_displayImage.size() == m_baseImage.size())
+    QRect dispCrop = scaledRect(crop(), m_displayImageScale).translated(-m_displayImageRect.topLeft());
+    if (m_displayImageEffects.flipHorizontal)
+    {
+        dispCrop.moveLeft(m_displayImageRect.width() - dispCrop.right() - 1);
+    }
+    if (m_displayImageEffects.flipVertical)
     {
-        return crop();
+        dispCrop.moveTop(m_displayImageRect.height() - dispCrop.bottom() - 1);
     }
-    const qreal dispW = static_cast<qreal>(m_displayImage.size().width());
-    const qreal baseW = static_cast<qreal>(m_baseImage.size().width());
-    const qreal fac = dispW / baseW;
-    const QRectF srcCrop = crop().toRectF();
-    return {{qRound(fac * srcCrop.left()), qRound(fac * srcCrop.top())}, displaySize()};
+    return dispCrop;
 }
 
 QPointF ReferenceImage::displayToBaseCoords(QPointF coords) const
@@ -373,9 +456,9 @@ QPointF ReferenceImage::displayToBaseCoords(QPointF coords) const
     {
         return coords;
     }
-    const QSizeF baseSize = m_baseImage.size().toSizeF();
-    const QSizeF dispSize = m_displayImage.size().toSizeF();
-    return {coords.x() * baseSize.width() / dispSize.width(), coords.y() * baseSize.height() / dispSize.height()};
+    if (m_displayImageEffects.flipHorizontal) coords.setX(m_displayImageRect.width() - coords.x());
+    if (m_displayImageEffects.flipVertical) coords.setY(m_displayImageRect.height() - coords.y());
+    return (coords + m_displayImageRect.topLeft().toPointF()) / m_displayImageScale;
 }
 
 QPointF ReferenceImage::baseToDisplayCoords(QPointF coords) const
@@ -384,45 +467,166 @@ QPointF ReferenceImage::baseToDisplayCoords(QPointF coords) const
     {
         return coords;
     }
-    const QSizeF baseSize = m_baseImage.size().toSizeF();
-    const QSizeF dispSize = m_displayImage.size().toSizeF();
-    return {coords.x() * dispSize.width() / baseSize.width(), coords.y() * dispSize.height() / baseSize.height()};
+    coords = coords * m_displayImageScale - m_displayImageRect.topLeft().toPointF();
+    if (m_displayImageEffects.flipHorizontal) coords.setX(m_displayImageRect.width() - coords.x());
+    if (m_displayImageEffects.flipVertical) coords.setY(m_displayImageRect.height() - coords.y());
+    return coords;
+}
+
+bool ReferenceImage::displayImageContains(const QRect &rect)
+{
+    const QMutexLocker lock(&m_displayImageMutex);
+    return !m_displayImage.isNull() && m_displayImageRect.contains(scaledRect(rect, m_displayImageScale));
 }
 
-void ReferenceImage::setBaseImage(const QImage &baseImage)
+void ReferenceImage::setBaseImage(const QImage &baseImage, QSize fullSize)
 {
-    const QSize oldBaseSize = m_baseImage.size();
+    const QSize oldBaseSize = m_baseImageSize;
     const QSize oldDisplaySize = displaySize();
+    if (!fullSize.isValid() || baseImage.isNull())
+    {
+        fullSize = baseImage.size();
+    }
+    const QRectF fullRect(QPointF(), fullSize.toSizeF());
 
     {
         const QMutexLocker lock(&m_baseImageMutex);
         m_baseImage = baseImage;
-        if (baseImage.size() != oldBaseSize)
+        m_baseImageSize = fullSize;
+        if (m_cropPending && !baseImage.isNull())
         {
-            m_crop = baseImage.rect();
+            // Apply the crop restored by fromJson keeping the current zoom
+            m_crop = m_crop.intersected(fullRect);
+            if (!m_crop.isValid())
+            {
+                m_crop = fullRect;
+            }
+            m_cropPending = false;
+        }
+        else
+        {
+            if (fullSize != oldBaseSize)
+            {
+                m_crop = fullRect;
+            }
+            setDisplaySize(oldDisplaySize.isEmpty() ? fullSize : fullSize.scaled(oldDisplaySize, Qt::KeepAspectRatio));
         }
-        setDisplaySize(oldDisplaySize.isEmpty() ? baseImage.size()
-                                                : baseImage.size().scaled(oldDisplaySize, Qt::KeepAspectRatio));
     }
 
+    m_evicted = false;
     checkHasAlpha();
     updateDisplayImage();
+    App::ghostRefInstance()->memoryBudget()->scheduleCheck();
     emit baseImageChanged(m_baseImage);
 }
 
+bool ReferenceImage::canEvictBaseImage() const
+{
+    // Linked copies have no compressed image of their own
+    return !m_baseImage.isNull() && !m_compressedImage.isEmpty() && !m_linkedCopyOf && !isLoading();
+}
+
+bool ReferenceImage::evictBaseImage()
+{
+    // The image pyramid can't be cleared while a redraw is using it
+    if (!canEvictBaseImage() || App::ghostRefInstance()->redrawScheduler()->isRedrawing(this))
+    {
+        return false;
+    }
+
+    {
+        const QMutexLocker lock(&m_baseImageMutex);
+        m_baseImage = QImage();
+    }
+    m_imagePyramid.setImage(QImage());
+    m_imagePyramidBytes = 0;
+    m_redrawBuffers = {};
+    {
+        const QMutexLocker lock(&m_displayImageMutex);
+        m_displayImage = QImage();
+        m_displayImageGrey = QImage();
+        m_previewImage = QImage();
+        m_previewImageGrey = QImage();
+    }
+
+    // The finished loader still holds the decoded image (and its entry in the image cache)
+    QObject::disconnect(&m_loaderWatcher);
+    m_loader = std::make_unique<RefImageLoader>();
+
+    m_evicted = true;
+    return true;
+}
+
+void ReferenceImage::restoreBaseImage()
+{
+    if (const ReferenceImageSP source = linkedCopyOf(); source && !isLoaded())
+    {
+        source->restoreBaseImage(); // Linked copies are given the image once the source is decoded
+        return;
+    }
+    if (m_evicted)
+    {
+        decodeBaseImage(displayImageScale());
+    }
+}
+
+void ReferenceImage::decodeFullImage()
+{
+    if (const ReferenceImageSP source = linkedCopyOf())
+    {
+        source->decodeFullImage(); // Linked copies are given the full image once the source is decoded
+        return;
+    }
+    if (isDownsampled())
+    {
+        decodeBaseImage(1.0);
+    }
+}
+
+void ReferenceImage::decodeBaseImage(qreal minScale)
+{
+    if (isLoading() || (m_compressedImage.isEmpty() && filepath().isEmpty()))
+    {
+        return;
+    }
+    m_cropPending = true; // Keeps the crop and zoom when the base image is set
+    m_redecoding = true;
+    const DecodeResolution resolution{minScale};
+    setLoader(m_compressedImage.isEmpty() ? std::make_unique<RefImageLoader>(filepath(), resolution)
+                                          : std::make_unique<RefImageLoader>(m_compressedImage, resolution,
+                                                                             m_compressedImageOwner,
+                                                                             m_compressedImageHash));
+}
+
 const QByteArray &ReferenceImage::ensureCompressedImage()
 {
     if (!m_baseImage.isNull() && m_compressedImage.isEmpty())
     {
-        const int formatQuality = -1; // 0-100 (100 = least compressed, -1 = default)
-
-        QBuffer buf(&m_compressedImage);
-        buf.open(QIODevice::WriteOnly);
-        m_baseImage.save(&buf, "PNG", formatQuality);
+        setCompressedImage(utils::encodeImage(m_baseImage, storedImageCodec()));
     }
     return m_compressedImage;
 }
 
+utils::ImageCodec ReferenceImage::storedImageCodec()
+{
+    const Preferences *prefs = appPrefs();
+    const QByteArray format = prefs->getEnumItem(Preferences::StoredImageFormat).value.toLatin1();
+
+    if (format == "webp" && utils::canEncodeImageFormat(format))
+    {
+        return {format, 100}; // Qt's WebP writer is lossless at quality 100
+    }
+    if (format != "png" && utils::canEncodeImageFormat(format))
+    {
+        return {format, -1};
+    }
+    if (format != "png")
+    {
+        qWarning() << "No image plugin available to write" << format << "images. Using PNG instead.";
+    }
+    return {"png", utils::pngQualityForLevel(prefs->getInt(Preferences::StoredImageCompression))};
+}
+
 QSize ReferenceImage::displaySize() const
 {
     return displaySizeF().toSize();
@@ -435,7 +639,7 @@ QSizeF ReferenceImage::displaySizeF() const
 
 QSize ReferenceImage::displaySizeFull() const
 {
-    const QSizeF dispSize = m_baseImage.size().toSizeF() * zoom();
+    const QSizeF dispSize = m_baseImageSize.toSizeF() * zoom();
     return {qCeil(dispSize.width()), qCeil(dispSize.height())};
 }
 
@@ -473,6 +677,54 @@ void ReferenceImage::setZoom(qreal value)
     emit zoomChanged(value);
 }
 
+void ReferenceImage::setFlipHorizontal(bool value)
+{
+    m_filpHorizontal = value;
+    onViewEffectsChanged();
+}
+
+void ReferenceImage::setFlipVertical(bool value)
+{
+    m_flipVertical = value;
+    onViewEffectsChanged();
+}
+
+void ReferenceImage::setSaturation(qreal value)
+{
+    m_saturation = std::clamp(value, 0., 1.);
+    onViewEffectsChanged();
+}
+
+void ReferenceImage::onViewEffectsChanged()
+{
+    bool needsRedraw = !m_paintTimeEffects;
+    if (!needsRedraw && !nearlyEqual(saturation(), 1.0))
+    {
+        // The grey copy is only rendered once the image is desaturated
+        const QMutexLocker lock(&m_displayImageMutex);
+        needsRedraw = m_displayImageGrey.isNull();
+    }
+    if (needsRedraw)
+    {
+        updateDisplayImage();
+    }
+    emit settingsChanged();
+}
+
+void ReferenceImage::setPaintTimeEffects(bool value)
+{
+    if (value != m_paintTimeEffects)
+    {
+        m_paintTimeEffects = value;
+        updateDisplayImage();
+    }
+}
+
+qreal ReferenceImage::displayImageScale() const
+{
+    return std::min(zoom(), 1.0);
+}
+
 void ReferenceImage::redrawImage()
 {
     m_displayImageUpdate.clear();
@@ -487,29 +739,92 @@ void ReferenceImage::redrawImage()
         return;
     }
 
-    const QSize dispImgSize = smallestSize(displaySizeFull(), baseImageCopy.size());
+    const qreal scale = displayImageScale();
+    const QRect cropRect = crop();
+    // The crop and display image are in full resolution coordinates. A downsampled base image is scaled up
+    // to match until the full image is decoded.
+    const QSize fullSize = m_baseImageSize;
 
     baseImageLock.unlock();
 
-    QImage redrawTarget;
+    const qreal sourceScale = scale * std::max(fullSize.width() / static_cast<qreal>(baseImageCopy.width()),
+                                               fullSize.height() / static_cast<qreal>(baseImageCopy.height()));
 
-    if (dispImgSize == baseImageCopy.size())
+    // Only render the tiles around the crop at the current zoom. Adding a tile of margin means small crop
+    // changes can be shown without waiting for a redraw.
+    if (m_imagePyramid.setImage(baseImageCopy) || m_previewImage.isNull())
     {
-        redrawTarget = baseImageCopy;
+        updatePreviewImage();
     }
-    else
+
+    const int margin = utils::ImagePyramid::tileSize;
+    const QRect region =
+        m_imagePyramid.tileAlignedRect(scaledRect(cropRect, scale).adjusted(-margin, -margin, margin, margin),
+                                       sourceScale);
+
+    // In paint time mode the effects are applied by drawDisplayImage instead
+    const bool paintTimeEffects = m_paintTimeEffects;
+    const bool desaturate = !nearlyEqual(saturation(), 1.0);
+
+    utils::ImageEffects effects;
+    if (!paintTimeEffects)
+    {
+        effects.flipHorizontal = flipHorizontal();
+        effects.flipVertical = flipVertical();
+        effects.saturation = desaturate ? saturation() : 1.0;
+    }
+
+    // Alternate between two buffers. The one used by the current display image is still shared with it
+    // but the other is normally free to be reused.
+    QImage &redrawTarget = m_redrawBuffers.at(m_nextRedrawBuffer);
+    m_nextRedrawBuffer = (m_nextRedrawBuffer + 1) % m_redrawBuffers.size();
+    const bool rendered = m_imagePyramid.render(region, sourceScale, redrawTarget, effects);
+    m_imagePyramidBytes = m_imagePyramid.cacheBytes();
+    if (!rendered)
+    {
+        return; // Cancelled by a newer request. The tiles that were rendered are kept for the next redraw.
+    }
+
+    QImage greyImage;
+    if (paintTimeEffects && desaturate)
     {
-        redrawTarget = baseImageCopy.scaled(dispImgSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        utils::ImageEffects greyEffects = effects;
+        greyEffects.saturation = 0.0;
+        if (!m_imagePyramid.render(region, sourceScale, greyImage, greyEffects))
+        {
+            return;
+        }
     }
-    redrawTarget.mirror(flipHorizontal(), flipVertical());
 
-    if (!nearlyEqual(saturation(), 1.0))
+    if (m_displayImageUpdate.test())
     {
-        utils::reduceSaturation(redrawTarget, saturation());
+        return; // Outdated by a newer request
     }
 
     const QMutexLocker displayImageLock(&m_displayImageMutex);
-    m_displayImage = QPixmap::fromImage(redrawTarget);
+    m_displayImage = redrawTarget;
+    m_displayImageGrey = std::move(greyImage);
+    m_displayImageEffects = effects;
+    m_displayImageRect = region;
+    m_displayImageScale = scale;
+    emit displayImageUpdated();
+}
+
+void ReferenceImage::updatePreviewImage()
+{
+    const QImage &image = m_imagePyramid.image();
+    QImage preview = image.width() > previewImageSize || image.height() > previewImageSize
+                         ? image.scaled(previewImageSize, previewImageSize, Qt::KeepAspectRatio)
+                         : image;
+    QImage previewGrey = preview.copy();
+    utils::reduceSaturation(previewGrey, 0.0);
+
+    {
+        const QMutexLocker displayImageLock(&m_displayImageMutex);
+        m_previewImage = std::move(preview);
+        m_previewImageGrey = std::move(previewGrey);
+    }
+    // Lets a new image be painted before its first redraw has finished
     emit displayImageUpdated();
 }
 
@@ -549,8 +864,10 @@ void ReferenceImage::setLinkedCopyOf(const ReferenceImageSP &refImage)
     m_linkedCopyOf = refImage.toWeakRef();
     if (refImage)
     {
-        setBaseImage(refImage->baseImage());
+        setBaseImage(refImage->baseImage(), refImage->baseImageSize());
         QObject::connect(refImage.get(), &ReferenceImage::baseImageChanged, this,
-                         [this](QImage &baseImage) { setBaseImage(baseImage); });
+                         [this, source = refImage.get()](QImage &baseImage) {
+                             setBaseImage(baseImage, source->baseImageSize());
+                         });
     }
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <memory>
 
 #include <QtCore/QFutureWatcher>
@@ -14,8 +15,7 @@
 #include "reference_loading.h"
 #include "types.h"
 
-// Defined in reference_image.cpp
-class ReferenceImageRedrawManager;
+#include "utils/image_pyramid.h"
 
 class ReferenceImage : public QObject
 {
@@ -23,7 +23,7 @@ class ReferenceImage : public QObject
     Q_DISABLE_COPY_MOVE(ReferenceImage)
 
     friend class ReferenceCollection;
-    friend class ReferenceImageRedrawManager;
+    friend class RedrawScheduler;
 
     using LoaderWatcher = QFutureWatcher<QVariant>;
 
@@ -34,26 +34,61 @@ class ReferenceImage : public QObject
     ReferenceImageWP m_linkedCopyOf;
 
     QByteArray m_compressedImage;
+    // Keeps m_compressedImage valid if it refers to memory it doesn't own (see RefImageLoader::fileDataOwner)
+    std::shared_ptr<const void> m_compressedImageOwner;
+    // utils::ImageCache::contentHash of m_compressedImage once it's known. Saves hashing it again for each decode.
+    QByteArray m_compressedImageHash;
     QImage m_baseImage;
-    QPixmap m_displayImage;
+    // The size of the image at full resolution. m_baseImage may be a downsampled proxy of it (see
+    // DecodeResolution). The crop and the display image are in full resolution coordinates. Kept when the
+    // base image is evicted.
+    QSize m_baseImageSize;
+    // Kept as a QImage in the format it's rendered in (RGB32 or ARGB32_Premultiplied) so redrawImage never
+    // creates pixmaps outside the GUI thread. Painting only reads the part that is visible.
+    QImage m_displayImage;
+    // Copy of m_displayImage with no saturation. Used to desaturate it when painting.
+    QImage m_displayImageGrey;
+    // The effects that are rendered into m_displayImage
+    utils::ImageEffects m_displayImageEffects;
+    // The region of the base image scaled by m_displayImageScale that m_displayImage contains (before flipping)
+    QRect m_displayImageRect;
+    qreal m_displayImageScale = 1.0;
+    // Small copy of the whole base image (and its grey copy) painted while the display image is redrawn for a
+    // crop it doesn't contain. Guarded by m_displayImageMutex.
+    QImage m_previewImage;
+    QImage m_previewImageGrey;
+    // Renders the display image. Only used by redrawImage.
+    utils::ImagePyramid m_imagePyramid;
+    std::atomic<qint64> m_imagePyramidBytes = 0; // m_imagePyramid.cacheBytes() after the last redraw
+    std::array<QImage, 2> m_redrawBuffers;
+    size_t m_nextRedrawBuffer = 0;
 
     bool m_hasAlpha = false;
 
+    // Set if the base image was evicted by the MemoryBudget or hasn't been decoded yet after loading a
+    // session. It's decoded from m_compressedImage (or m_filepath if there isn't one) by restoreBaseImage.
+    bool m_evicted = false;
+    // Set while the base image is decoded again from the same data at a higher resolution
+    bool m_redecoding = false;
+
     QMutex m_baseImageMutex;
     QMutex m_displayImageMutex;
-    std::unique_ptr<ReferenceImageRedrawManager> m_redrawManager;
-    
+
     std::atomic_flag m_displayImageUpdate; // Flag set if the display image needs redrawing.
 
     QString m_filepath;
     QString m_name;
     QRectF m_crop;
+    // Set if m_crop was restored before the base image finished loading. Applied in setBaseImage.
+    bool m_cropPending = false;
     qreal m_zoom = 1.0;
     qreal m_saturation = 1.0;
     bool m_savedAsLink = false;
     bool m_filpHorizontal = false;
     bool m_flipVertical = false;
     bool m_smoothFiltering = true;
+    // Apply flips and saturation when painting the display image instead of rendering them into it
+    std::atomic_bool m_paintTimeEffects;
 
 public:
     ~ReferenceImage() override;
@@ -68,6 +103,12 @@ public:
     void reload();
 
     void fromJson(const QJsonObject &json, RefImageLoaderUP &&loader);
+    // Loads a reference from a session file. compressedImage (the image stored in the session, if any) is
+    // only decoded once the image is shown (see restoreBaseImage). compressedImageOwner keeps it valid if it
+    // refers to the memory mapped session file.
+    void fromSessionJson(const QJsonObject &json,
+                         const QByteArray &compressedImage,
+                         const std::shared_ptr<const void> &compressedImageOwner = {});
     QJsonObject toJson() const;
 
     const RefImageLoaderUP &loader() const;
@@ -79,15 +120,54 @@ public:
     void setFilepath(const QString &filepath);
 
     const QImage &baseImage() const;
-    void setBaseImage(const QImage &baseImage);
+    // fullSize is the size of the image that baseImage was downsampled from. Defaults to baseImage's size.
+    void setBaseImage(const QImage &baseImage, QSize fullSize = {});
+    // The size of the image at full resolution. Also valid while the base image is evicted.
+    QSize baseImageSize() const;
+    // True if the base image is a downsampled proxy of the full resolution image
+    bool isDownsampled() const;
+    // The size of the base image relative to the full resolution image
+    qreal baseImageScale() const;
+    // Starts decoding the full resolution image if the base image is downsampled. Called automatically once
+    // the image is zoomed in further than the proxy's resolution.
+    void decodeFullImage();
+
+    // Frees the decoded base image and everything rendered from it. Only done for images that can be decoded
+    // again from their compressed image. Returns false if the image can't be evicted right now.
+    bool canEvictBaseImage() const;
+    bool evictBaseImage();
+    bool isEvicted() const;
+    // Memory used by the levels and tiles rendered from the base image (see ImagePyramid::cacheBytes). Updated
+    // by each redraw. Freed with the base image when it's evicted.
+    qint64 imagePyramidBytes() const;
+    // Starts decoding an evicted base image. The crop and zoom are kept. Linked copies restore the image they
+    // take their data from.
+    void restoreBaseImage();
 
     const QByteArray &compressedImage() const;
+    // Must be kept with any copy of compressedImage() (see RefImageLoader::fileDataOwner)
+    const std::shared_ptr<const void> &compressedImageOwner() const;
+    // Empty if it hasn't been calculated yet (see RefImageLoader::fileDataHash)
+    const QByteArray &compressedImageHash() const;
     const QByteArray &ensureCompressedImage();
-    void setCompressedImage(const QByteArray &value);
-    void setCompressedImage(QByteArray &&value);
-
-    const QPixmap &displayImage();
+    // The codec used to compress images that are stored in session files. Set by the StoredImageFormat
+    // and StoredImageCompression preferences. Must be called from the GUI thread.
+    static utils::ImageCodec storedImageCodec();
+    void setCompressedImage(const QByteArray &value,
+                            const std::shared_ptr<const void> &owner = {},
+                            const QByteArray &hash = {});
+    void setCompressedImage(QByteArray &&value,
+                            const std::shared_ptr<const void> &owner = {},
+                            const QByteArray &hash = {});
+
+    const QImage &displayImage();
     QMutexLocker<QMutex> lockDisplayImage();
+    // Effects that aren't rendered into the display image so must be applied when painting it
+    utils::ImageEffects paintEffects() const;
+    // Draws the cropped display image to target applying paintEffects. The display image must be locked.
+    // If the display image is outdated by a zoom or crop change then the old display image or the preview
+    // image is drawn without smooth filtering until the redraw finishes.
+    void drawDisplayImage(QPainter &painter, const QRectF &target) const;
 
     const QString &name() const;
     void setName(const QString &newName);
@@ -99,6 +179,8 @@ public:
     void setCropF(QRectF value);
     void shiftCropF(QPointF shiftBy);
 
+    // The crop in display image coordinates. The display image only contains the part of the base image
+    // around the crop so this is also offset by the display image's position.
     QRect displayImageCrop() const;
 
     // Converts display image coordinates to base image coordinates
@@ -108,6 +190,8 @@ public:
     QPointF baseToDisplayCoords(QPointF coords) const;
 
     bool isLoaded() const;
+    // Returns true if this item's loader has not finished yet
+    bool isLoading() const;
     // Returns true if this item is loaded or in the process of loading
     bool isValid() const;
     const QString &errorMessage() const;
@@ -170,7 +254,19 @@ private:
     void checkHasAlpha();
 
     void onLoaderFinished();
+    // Decodes the base image again from its compressed image (or filepath) at minScale of the full size
+    void decodeBaseImage(qreal minScale);
+    // Called when the flips or saturation change. Only redraws the display image if necessary.
+    void onViewEffectsChanged();
+    void setPaintTimeEffects(bool value);
     void redrawImage();
+    // Downscales the pyramid's image into m_previewImage. Called by redrawImage when the base image changes.
+    void updatePreviewImage();
+    // The scale of the display image relative to the base image. Images are never drawn larger than the
+    // base image.
+    qreal displayImageScale() const;
+    // Returns true if the current display image contains all of rect (in base image coordinates)
+    bool displayImageContains(const QRect &rect);
 };
 
 // inline definitions
@@ -182,7 +278,7 @@ inline void ReferenceImage::setFilepath(const QString &filepath)
     emit filepathChanged(m_filepath);
 }
 
-inline const QPixmap &ReferenceImage::displayImage()
+inline const QImage &ReferenceImage::displayImage()
 {
     return m_displayImage;
 }
@@ -192,6 +288,8 @@ inline QMutexLocker<QMutex> ReferenceImage::lockDisplayImage()
     return QMutexLocker(&m_displayImageMutex);
 }
 
+inline qint64 ReferenceImage::imagePyramidBytes() const { return m_imagePyramidBytes; }
+
 inline const QImage &ReferenceImage::baseImage() const
 {
     return m_baseImage;
@@ -199,9 +297,30 @@ inline const QImage &ReferenceImage::baseImage() const
 
 inline const QByteArray &ReferenceImage::compressedImage() const { return m_compressedImage; }
 
-inline void ReferenceImage::setCompressedImage(const QByteArray &value) { m_compressedImage = value; }
+inline const std::shared_ptr<const void> &ReferenceImage::compressedImageOwner() const
+{
+    return m_compressedImageOwner;
+}
 
-inline void ReferenceImage::setCompressedImage(QByteArray &&value) { m_compressedImage = std::move(value); }
+inline const QByteArray &ReferenceImage::compressedImageHash() const { return m_compressedImageHash; }
+
+inline void ReferenceImage::setCompressedImage(const QByteArray &value,
+                                               const std::shared_ptr<const void> &owner,
+                                               const QByteArray &hash)
+{
+    m_compressedImage = value;
+    m_compressedImageOwner = owner;
+    m_compressedImageHash = hash;
+}
+
+inline void ReferenceImage::setCompressedImage(QByteArray &&value,
+                                               const std::shared_ptr<const void> &owner,
+                                               const QByteArray &hash)
+{
+    m_compressedImage = std::move(value);
+    m_compressedImageOwner = owner;
+    m_compressedImageHash = hash;
+}
 
 inline const QString &ReferenceImage::name() const
 {
@@ -217,8 +336,22 @@ inline QRect ReferenceImage::crop() const
             qCeil(m_crop.height() - epsilon)};
 }
 
+inline QSize ReferenceImage::baseImageSize() const { return m_baseImageSize; }
+
+inline bool ReferenceImage::isDownsampled() const
+{
+    return !m_baseImage.isNull() && m_baseImage.size() != m_baseImageSize;
+}
+
+inline qreal ReferenceImage::baseImageScale() const
+{
+    return m_baseImageSize.isEmpty() ? 1.0 : m_baseImage.width() / static_cast<qreal>(m_baseImageSize.width());
+}
+
 inline bool ReferenceImage::isLoaded() const { return !m_baseImage.isNull(); }
 
+inline bool ReferenceImage::isEvicted() const { return m_evicted; }
+
 inline void ReferenceImage::setCrop(QRect value)
 {
     setCropF(value.toRectF());
@@ -248,29 +381,10 @@ inline ReferenceImageSP ReferenceImage::linkedCopyOf() const
 
 inline bool ReferenceImage::flipHorizontal() const { return m_filpHorizontal; }
 
-inline void ReferenceImage::setFlipHorizontal(bool value)
-{
-    m_filpHorizontal = value;
-    updateDisplayImage();
-}
-
 inline bool ReferenceImage::flipVertical() const { return m_flipVertical; }
 
-inline void ReferenceImage::setFlipVertical(bool value)
-{
-    m_flipVertical = value;
-    updateDisplayImage();
-}
-
 inline qreal ReferenceImage::saturation() const { return m_saturation; }
 
-inline void ReferenceImage::setSaturation(qreal value)
-{
-    m_saturation = std::clamp(value, 0., 1.);
-    updateDisplayImage();
-    emit settingsChanged();
-}
-
 inline bool ReferenceImage::smoothFiltering() const { return m_smoothFiltering; }
 inline void ReferenceImage::setSmoothFiltering(bool value)
 {
@@ -1,9 +1,15 @@
 #include "reference_loading.h"
 
+#include <algorithm>
+
+#include <QtCore/QBuffer>
 #include <QtCore/QFileInfo>
 #include <QtCore/QFuture>
 #include <QtCore/QMimeData>
 #include <QtCore/QMimeDatabase>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+#include <QtCore/QtMath>
 
 #include <QtGui/QClipboard>
 #include <QtGui/QDragEnterEvent>
@@ -12,6 +18,7 @@
 #include <QtGui/QImage>
 #include <QtGui/QImageReader>
 #include <QtGui/QPixmap>
+#include <QtGui/QScreen>
 
 #include "app.h"
 #include "reference_collection.h"
@@ -19,6 +26,8 @@
 
 #include "widgets/reference_window.h"
 
+#include "utils/image.h"
+#include "utils/image_cache.h"
 #include "utils/network_download.h"
 #include "utils/result.h"
 
@@ -26,13 +35,53 @@ namespace
 {
     struct LoadedImage
     {
+        // Full resolution images are loaded through the image cache so that loading identical file data
+        // shares the decoded image. Null if the image was downsampled.
+        utils::ImageCache::EntrySP cacheEntry;
         QByteArray fileData;
         QImage image;
+        QSize fullSize;
+        std::shared_ptr<const void> fileDataOwner; // See RefImageLoader::fileDataOwner
+        QByteArray fileDataHash;                   // See RefImageLoader::fileDataHash
     };
 
     using ImageResult = utils::result<LoadedImage, QString>;
 
-    ImageResult loadLocalImage(const QString &filepath)
+    ImageResult decodeImage(const QByteArray &fileData,
+                            const DecodeResolution &resolution,
+                            const std::shared_ptr<const void> &fileDataOwner = {},
+                            const QByteArray &fileDataHash = {})
+    {
+        // Only the header is read to get the size
+        QBuffer buffer;
+        buffer.setData(fileData);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader imageReader(&buffer);
+
+        const QSize fullSize = imageReader.size();
+        if (const QSize decodeSize = resolution.decodeSize(fullSize); fullSize.isValid() && decodeSize != fullSize)
+        {
+            imageReader.setScaledSize(decodeSize);
+            if (QImage image = imageReader.read(); !image.isNull())
+            {
+                utils::convertToRenderFormat(image); // So ImagePyramid doesn't keep a converted copy
+                return LoadedImage{nullptr, fileData, image, fullSize, fileDataOwner, fileDataHash};
+            }
+        }
+
+        if (utils::ImageCache::EntrySP entry =
+                utils::ImageCache::instance().decode(fileData, fileDataOwner, fileDataHash))
+        {
+            return LoadedImage{
+                entry, entry->fileData, entry->image, entry->image.size(), entry->fileDataOwner, entry->hash};
+        }
+        return ImageResult::Err("Error loading QImage from file data");
+    }
+
+    // Loads the image at filepath. Returns early with an error if promise is canceled.
+    ImageResult loadLocalImage(const QString &filepath,
+                               const DecodeResolution &resolution,
+                               const QPromise<ImageResult> &promise)
     {
         const qint64 maxFileSize = 1e9;
 
@@ -51,9 +100,14 @@ namespace
                 return ImageResult::Err("Exceeded maximum file size");
             }
 
-            if (QImage image; image.loadFromData(fileData))
+            if (promise.isCanceled())
             {
-                return LoadedImage(fileData, image);
+                return ImageResult::Err("Canceled");
+            }
+
+            if (ImageResult result = decodeImage(fileData, resolution); result.isOk())
+            {
+                return result;
             }
             qCritical() << "Unable to load file " << filepath;
             return ImageResult::Err("Unable to load file");
@@ -63,6 +117,47 @@ namespace
         return ImageResult::Err(msg.arg(filepath));
     }
 
+    // Task that loads an image in a thread from the global thread pool. The image is either read
+    // from a local file or decoded from file data already in memory (e.g. from a session file).
+    class ImageLoadTask : public QRunnable
+    {
+        QString m_filepath;
+        QByteArray m_fileData;
+        std::shared_ptr<const void> m_fileDataOwner;
+        QByteArray m_fileDataHash;
+        DecodeResolution m_resolution;
+        QPromise<ImageResult> m_promise;
+
+    public:
+        ImageLoadTask(QString filepath, const DecodeResolution &resolution)
+            : m_filepath(std::move(filepath)),
+              m_resolution(resolution)
+        {}
+        ImageLoadTask(QByteArray fileData,
+                      std::shared_ptr<const void> fileDataOwner,
+                      QByteArray fileDataHash,
+                      const DecodeResolution &resolution)
+            : m_fileData(std::move(fileData)),
+              m_fileDataOwner(std::move(fileDataOwner)),
+              m_fileDataHash(std::move(fileDataHash)),
+              m_resolution(resolution)
+        {}
+
+        QFuture<ImageResult> future() { return m_promise.future(); }
+
+        void run() override
+        {
+            m_promise.start();
+            if (!m_promise.isCanceled())
+            {
+                m_promise.addResult(m_filepath.isEmpty()
+                                        ? decodeImage(m_fileData, m_resolution, m_fileDataOwner, m_fileDataHash)
+                                        : loadLocalImage(m_filepath, m_resolution, m_promise));
+            }
+            m_promise.finish();
+        }
+    };
+
     ReferenceCollection &getRefCollection()
     {
         return *App::ghostRefInstance()->referenceItems();
@@ -154,7 +249,14 @@ ReferenceImageSP refLoad::fromUrl(const QUrl &url)
     const QString name = stripExt(url.fileName());
     ReferenceImageSP refImage = getRefCollection().newReferenceImage(name);
     refImage->setFilepath(url.toLocalFile());
-    refImage->setLoader(std::make_unique<RefImageLoader>(url));
+    // New references are shown at no more than the screen's size so they start out decoded at that size. The
+    // full resolution image is decoded once they're zoomed in.
+    DecodeResolution resolution{0.0};
+    if (const QScreen *screen = QGuiApplication::primaryScreen())
+    {
+        resolution.fitSize = screen->size() * screen->devicePixelRatio();
+    }
+    refImage->setLoader(std::make_unique<RefImageLoader>(url, resolution));
 
     return refImage;
 }
@@ -230,24 +332,40 @@ bool refLoad::pasteRefsFromClipboard(ReferenceWindow *into)
     return true;
 }
 
-RefImageLoader::RefImageLoader(const QUrl &url)
+template <typename Task>
+void RefImageLoader::startLoadTask(Task *task)
+{
+    const QFuture<ImageResult> taskFuture = task->future();
+    m_pendingLoad = QFuture<void>(taskFuture);
+
+    // Run the continuation in the main thread so that this loader is never accessed from the task's thread
+    setFuture(taskFuture.then(QCoreApplication::instance(),
+                              [this, alive = std::weak_ptr<bool>(m_alive)](const ImageResult &result) {
+                                  if (alive.expired())
+                                  {
+                                      return QVariant();
+                                  }
+                                  if (result.isErr())
+                                  {
+                                      setError(result.error());
+                                      return QVariant();
+                                  }
+                                  m_cacheEntry = result->cacheEntry;
+                                  m_fileData = result->fileData;
+                                  m_fileDataOwner = result->fileDataOwner;
+                                  m_fileDataHash = result->fileDataHash;
+                                  m_fullSize = result->fullSize;
+                                  return QVariant::fromValue(result->image);
+                              }));
+
+    QThreadPool::globalInstance()->start(task);
+}
+
+RefImageLoader::RefImageLoader(const QUrl &url, const DecodeResolution &resolution)
 {
     if (url.isLocalFile())
     {
-        ImageResult result = loadLocalImage(url.toLocalFile());
-        if (result.isOk())
-        {
-            auto value = result.value();
-            m_fileData = value.fileData;
-            promise().addResult(value.image);
-        }
-        else
-        {
-            setError(result.error());
-        }
-
-        promise().finish();
-        setFuture(promise().future());
+        startLoadTask(new ImageLoadTask(url.toLocalFile(), resolution));
     }
     else
     {
@@ -259,9 +377,12 @@ RefImageLoader::RefImageLoader(const QUrl &url)
             {
                 setError(m_download->errorMessage());
             }
-            else if (image.loadFromData(result))
+            else if ((m_cacheEntry = utils::ImageCache::instance().decode(result)))
             {
-                m_fileData = result;
+                m_fileData = m_cacheEntry->fileData;
+                m_fileDataOwner = m_cacheEntry->fileDataOwner;
+                m_fileDataHash = m_cacheEntry->hash;
+                image = m_cacheEntry->image;
             }
             else
             {
@@ -273,8 +394,18 @@ RefImageLoader::RefImageLoader(const QUrl &url)
     }
 }
 
-RefImageLoader::RefImageLoader(const QString &filepath)
-    : RefImageLoader(QUrl::fromLocalFile(filepath))
+RefImageLoader::~RefImageLoader()
+{
+    m_pendingLoad.cancel();
+}
+
+QFuture<QByteArray> RefImageLoader::downloadFuture() const
+{
+    return m_download ? m_download->future() : QFuture<QByteArray>();
+}
+
+RefImageLoader::RefImageLoader(const QString &filepath, const DecodeResolution &resolution)
+    : RefImageLoader(QUrl::fromLocalFile(filepath), resolution)
 {
 }
 
@@ -296,19 +427,32 @@ RefImageLoader::RefImageLoader(const QPixmap &pixmap)
     : RefImageLoader(pixmap.toImage())
 {}
 
-RefImageLoader::RefImageLoader(const QByteArray &data)
+RefImageLoader::RefImageLoader(const QByteArray &data,
+                               const DecodeResolution &resolution,
+                               std::shared_ptr<const void> dataOwner,
+                               const QByteArray &dataHash)
+    : m_fileData(data),
+      m_fileDataOwner(dataOwner),
+      m_fileDataHash(dataHash)
 {
-    setFuture(promise().future());
-    if (QImage image; image.loadFromData(data))
+    startLoadTask(new ImageLoadTask(data, std::move(dataOwner), dataHash, resolution));
+}
+
+QSize DecodeResolution::decodeSize(QSize fullSize) const
+{
+    qreal scale = minScale;
+    if (fitSize.isValid() && !fullSize.isEmpty())
     {
-        m_fileData = data;
-        promise().addResult(image);
+        scale = std::max(scale, std::min(fitSize.width() / static_cast<qreal>(fullSize.width()),
+                                         fitSize.height() / static_cast<qreal>(fullSize.height())));
     }
-    else
+
+    // Downsampling by less than half saves little and the full image will probably be needed soon
+    if (scale > 0.5 || fullSize.isEmpty())
     {
-        setError("Error loading QImage from file data");
+        return fullSize;
     }
-    promise().finish();
+    return {std::max(1, qCeil(fullSize.width() * scale)), std::max(1, qCeil(fullSize.height() * scale))};
 }
 
 QImage RefImageLoader::image() const
@@ -316,3 +460,4 @@ QImage RefImageLoader::image() const
     const QFuture<QVariant> thisFuture = future();
     return thisFuture.isResultReadyAt(0) ? thisFuture.result().value<QImage>() : QImage();
 }
+
@@ -6,10 +6,12 @@
 #include <QtCore/QByteArray>
 #include <QtCore/QFuture>
 #include <QtCore/QPromise>
+#include <QtCore/QSize>
 #include <QtCore/QString>
 #include <QtCore/QVariant>
 
 #include "types.h"
+#include "utils/image_cache.h"
 #include "utils/network_download.h"
 
 class QDragEnterEvent;
@@ -80,25 +82,70 @@ public:
     virtual RefType type() const = 0;
 };
 
+// The resolution an image is decoded at. Images that are displayed much smaller than their full size can be
+// downsampled while they're decoded (which is far cheaper than decoding them at full size for JPEGs). The
+// default decodes at full resolution.
+struct DecodeResolution
+{
+    // Never decode at less than this fraction of the full size
+    qreal minScale = 1.0;
+    // Decode at the size that fits in fitSize if that's larger than minScale allows. Ignored if invalid.
+    QSize fitSize;
+
+    // The size to decode an image of fullSize at
+    QSize decodeSize(QSize fullSize) const;
+};
+
 class RefImageLoader : public RefLoader
 {
     Q_DISABLE_COPY_MOVE(RefImageLoader)
 
     std::unique_ptr<utils::NetworkDownload> m_download = nullptr;
     QByteArray m_fileData;
+    std::shared_ptr<const void> m_fileDataOwner;
+    QByteArray m_fileDataHash;
+    // Keeps the loaded image shared with other loaders of the same file data. Null if it was downsampled.
+    utils::ImageCache::EntrySP m_cacheEntry;
+    QSize m_fullSize;
+
+    // Load running in a thread pool thread. Canceled if this loader is destroyed before it finishes.
+    QFuture<void> m_pendingLoad;
+    // Expires when this loader is destroyed. Checked by continuations that capture this.
+    std::shared_ptr<bool> m_alive = std::make_shared<bool>(true);
 
 public:
     RefImageLoader() = default;
-    explicit RefImageLoader(const QUrl &url);
-    explicit RefImageLoader(const QString &filepath);
+    explicit RefImageLoader(const QUrl &url, const DecodeResolution &resolution = {});
+    explicit RefImageLoader(const QString &filepath, const DecodeResolution &resolution = {});
     explicit RefImageLoader(const QImage &image);
     explicit RefImageLoader(const QPixmap &pixmap);
-    explicit RefImageLoader(const QByteArray &data);
-    ~RefImageLoader() override = default;
-
+    // dataOwner keeps data valid if it refers to memory it doesn't own (see fileDataOwner). dataHash is
+    // data's hash if it's already known (see fileDataHash).
+    explicit RefImageLoader(const QByteArray &data,
+                            const DecodeResolution &resolution = {},
+                            std::shared_ptr<const void> dataOwner = {},
+                            const QByteArray &dataHash = {});
+    ~RefImageLoader() override;
+
+    // Available while loading if the loader was given the file data
     const QByteArray &fileData() const;
+    // Keeps fileData valid if it refers to memory that it doesn't own (e.g. a memory mapped session file). Must
+    // be kept with any copy of fileData. Null if fileData owns its memory.
+    const std::shared_ptr<const void> &fileDataOwner() const;
+    // utils::ImageCache::contentHash of fileData. Empty if it hasn't been calculated (e.g. the image was
+    // downsampled so it wasn't cached).
+    const QByteArray &fileDataHash() const;
+    // The data being downloaded if the image is loaded from a remote URL. Invalid otherwise.
+    QFuture<QByteArray> downloadFuture() const;
     QImage image() const;
+    // The size of the image at full resolution. Larger than image() if it was downsampled.
+    QSize fullSize() const;
     RefType type() const override { return RefType::Image; }
+
+private:
+    // Starts task in the global thread pool. The task's result is applied to this loader in the main thread.
+    template <typename Task>
+    void startLoadTask(Task *task);
 };
 
 inline QPromise<QVariant> &RefLoader::promise() { return m_promise; }
@@ -130,4 +177,19 @@ inline const QString &RefLoader::errorMessage() const
 inline const QByteArray &RefImageLoader::fileData() const
 {
     return m_fileData;
-}
\ No newline at end of file
+}
+
+inline const std::shared_ptr<const void> &RefImageLoader::fileDataOwner() const
+{
+    return m_fileDataOwner;
+}
+
+inline const QByteArray &RefImageLoader::fileDataHash() const
+{
+    return m_fileDataHash;
+}
+
+inline QSize RefImageLoader::fullSize() const
+{
+    return m_fullSize.isValid() ? m_fullSize : image().size();
+}
@@ -1,22 +1,29 @@
 #include "saving.h"
 
-#include <limits>
+#include <algorithm>
+#include <memory>
 
-#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
+#include <QtCore/QHash>
 #include <QtCore/QJsonArray>
 #include <QtCore/QJsonDocument>
 #include <QtCore/QJsonObject>
 #include <QtCore/QMap>
 #include <QtCore/QMimeData>
+#include <QtCore/QPromise>
+#include <QtCore/QRunnable>
 #include <QtCore/QSaveFile>
+#include <QtCore/QSet>
 #include <QtCore/QStandardPaths>
 #include <QtCore/QString>
 #include <QtCore/QTemporaryFile>
+#include <QtCore/QThreadPool>
 
 #include <QtGui/QDropEvent>
 #include <QtGui/QImage>
+#include <QtGui/QImageReader>
 
 #include <QtWidgets/QFileDialog>
 
@@ -24,14 +31,61 @@
 #include "preferences.h"
 #include "reference_collection.h"
 #include "reference_image.h"
+#include "utils/image_cache.h"
 #include "utils/zip_file.h"
 #include "widgets/main_toolbar.h"
 #include "widgets/reference_window.h"
 
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif // Q_OS_WIN
+
 namespace
 {
 
     const char *const sessionJsonName = "session.json";
+    // The version of the session file layout, stored as "sessionFormat" in session.json. It's increased whenever
+    // older versions of the application would misread a file, and files with a higher version than this are
+    // refused when loading instead of losing their images. Version 1 (no "sessionFormat") stores each image in
+    // an entry named after its reference. Version 2 stores images in entries named by their content's hash
+    // (see writeSessionZip). Releases from before version 2 load version 2 files without their images.
+    const int sessionFormat = 2;
+
+    // Whether images loaded from a session refer to its memory mapped file instead of being copied out of it.
+    // Windows can't replace or remove a file while it's mapped, which saving and autosave need to do.
+#ifdef Q_OS_WIN
+    const bool keepSessionsMapped = false;
+#else
+    const bool keepSessionsMapped = true;
+#endif // Q_OS_WIN
+
+    // The session files that loaded images refer to (see keepSessionsMapped) by absolute path. Each reader is
+    // owned by the images that refer to its file (see ReferenceImage::compressedImageOwner) so the file is
+    // unmapped once nothing uses them. The files aren't modified in place while they're mapped: incremental
+    // saves only append to them and full saves replace them with a new file. A file that's truncated by
+    // something else while it's mapped still crashes when its images are decoded.
+    QList<std::pair<QString, std::weak_ptr<const utils::ZipFileReader>>> &mappedSessions()
+    {
+        static QList<std::pair<QString, std::weak_ptr<const utils::ZipFileReader>>> readers;
+        return readers;
+    }
+
+    void addMappedSession(const QString &filepath, const std::shared_ptr<const utils::ZipFileReader> &reader)
+    {
+        auto &readers = mappedSessions();
+        readers.removeIf([](const auto &mapped) { return mapped.second.expired(); });
+        readers.push_back({QFileInfo(filepath).absoluteFilePath(), reader});
+    }
+
+    bool isMappedSession(const QString &filepath)
+    {
+        const QString absolutePath = QFileInfo(filepath).absoluteFilePath();
+        return std::any_of(mappedSessions().cbegin(), mappedSessions().cend(), [&](const auto &mapped) {
+            return mapped.first == absolutePath && !mapped.second.expired();
+        });
+    }
 
     const QString &allFilterStr()
     {
@@ -68,6 +122,139 @@ namespace
         return dir;
     }
 
+    class CompressImageTask : public QRunnable
+    {
+        QImage m_image;
+        utils::ImageCodec m_codec;
+        QPromise<QByteArray> m_promise;
+
+    public:
+        CompressImageTask(QImage image, utils::ImageCodec codec)
+            : m_image(std::move(image)),
+              m_codec(std::move(codec))
+        {}
+
+        QFuture<QByteArray> future() { return m_promise.future(); }
+
+        void run() override
+        {
+            m_promise.start();
+            m_promise.addResult(utils::encodeImage(m_image, m_codec));
+            m_promise.finish();
+        }
+    };
+
+    // Compresses the images of refItems that don't have compressed data yet (e.g. pasted images) in
+    // the global thread pool and stores the result in each ReferenceImage. Blocks until all are done. Saving
+    // is synchronous (its callers need to know whether it succeeded, e.g. before quitting) so the GUI thread
+    // waits for the slowest image. Autosave doesn't block as it compresses in AutosaveTask instead.
+    void compressInParallel(const QList<ReferenceImageSP> &refItems)
+    {
+        const utils::ImageCodec codec = ReferenceImage::storedImageCodec();
+        QList<std::pair<ReferenceImageSP, QFuture<QByteArray>>> pending;
+        QSet<const ReferenceImage *> started;
+        // References that share a base image (e.g. duplicates) share its compressed data
+        QHash<qint64, QFuture<QByteArray>> startedImages;
+
+        for (const auto &refItem : refItems)
+        {
+            if (refItem->compressedImage().isEmpty() && !refItem->baseImage().isNull()
+                && !started.contains(refItem.get()))
+            {
+                started.insert(refItem.get());
+                const qint64 imageKey = refItem->baseImage().cacheKey();
+                if (const auto found = startedImages.constFind(imageKey); found != startedImages.cend())
+                {
+                    pending.push_back({refItem, found.value()});
+                    continue;
+                }
+
+                auto *task = new CompressImageTask(refItem->baseImage(), codec);
+                pending.push_back({refItem, task->future()});
+                startedImages.insert(imageKey, task->future());
+                QThreadPool::globalInstance()->start(task);
+            }
+        }
+
+        for (auto &[refItem, future] : pending)
+        {
+            refItem->setCompressedImage(future.result());
+        }
+    }
+
+    // The entries of a session file that are used by the session
+    struct SessionContents
+    {
+        // The data of each image entry by entry name. The arrays are shared with the ReferenceImages'
+        // compressed images so unchanged images are found by their data instead of hashing it again.
+        QMap<QString, QByteArray> imageEntries;
+        // Keep the data of imageEntries valid if it refers to a memory mapped session file (see
+        // ReferenceImage::compressedImageOwner). Also stops the data's address from being reused by other data.
+        QMap<QString, std::shared_ptr<const void>> imageEntryOwners;
+        // The name of the image entry each reference's image is stored in
+        QMap<QString, QString> referenceEntries;
+        qint64 sessionJsonSize = 0;
+    };
+
+    // What was last written to (or loaded from) the current session file. Used by incremental saves
+    // to only write new or changed images.
+    struct SessionFileState
+    {
+        QString filepath;
+        // Used to check that the file hasn't been changed by something else since it was saved
+        qint64 fileSize = 0;
+        QDateTime lastModified;
+
+        SessionContents contents;
+
+        void reset(const QString &path, const SessionContents &newContents);
+        bool canAppendTo(const QString &path) const;
+        // Size of the entries in the file that are part of the session. The rest of the file is mostly
+        // superseded entries left by incremental saves.
+        qint64 liveBytes() const;
+    };
+
+    void SessionFileState::reset(const QString &path, const SessionContents &newContents)
+    {
+        filepath = path;
+        contents = newContents;
+
+        const QFileInfo fileInfo(filepath);
+        fileSize = fileInfo.size();
+        lastModified = fileInfo.lastModified();
+    }
+
+    bool SessionFileState::canAppendTo(const QString &path) const
+    {
+        if (path.isEmpty() || path != filepath)
+        {
+            return false;
+        }
+        const QFileInfo fileInfo(path);
+        if (!fileInfo.isFile() || fileInfo.size() != fileSize || fileInfo.lastModified() != lastModified)
+        {
+            return false;
+        }
+        // Rewrite the whole file once over half of it is superseded entries
+        return fileSize - liveBytes() <= fileSize / 2;
+    }
+
+    qint64 SessionFileState::liveBytes() const
+    {
+        qint64 total = contents.sessionJsonSize;
+        for (const auto &data : contents.imageEntries)
+        {
+            total += data.size();
+        }
+        return total;
+    }
+
+    SessionFileState &sessionFileState()
+    {
+        static SessionFileState state;
+        return state;
+    }
+
     // Returns true if refItem should be stored as a file in the session ZIP when saving.
     bool shouldStoreRefItem(const ReferenceImageSP &refItem)
     {
@@ -87,33 +274,217 @@ namespace
         return true;
     }
 
-    QByteArray createSessionZip()
+    // The name of the entry that stores compressed image data. Identical images are stored once in the
+    // same entry.
+    QString imageEntryName(const sessionSaving::SessionSnapshot::Image &image)
     {
-        const App *app = App::ghostRefInstance();
-        const QJsonDocument json = sessionSaving::sessionToJson();
+        const QByteArray hash = image.compressedDataHash.isEmpty()
+                                    ? utils::ImageCache::contentHash(image.compressedData)
+                                    : image.compressedDataHash;
+        return "images/" + QString::fromLatin1(hash.toHex());
+    }
 
-        utils::ZipFile zipFile;
-        zipFile.addFile(sessionJsonName, json.toJson());
+    // The data of an image that was still loading when the snapshot was taken. Read from the local file it's
+    // loaded from or taken from its download if that has finished. Downloads aren't waited for as they finish
+    // in the GUI thread's event loop, which may be the thread that's writing.
+    QByteArray loadingImageData(const sessionSaving::SessionSnapshot::Image &image)
+    {
+        if (!image.loadingFile.isEmpty() && QImageReader(image.loadingFile).canRead())
+        {
+            QFile file(image.loadingFile);
+            if (file.open(QIODevice::ReadOnly))
+            {
+                return file.readAll();
+            }
+            qWarning() << "Unable to read" << image.loadingFile << "to save" << image.name;
+        }
+        if (image.download.isFinished() && image.download.resultCount() > 0)
+        {
+            return image.download.result();
+        }
+        return {};
+    }
 
-        for (const auto &refWindow : app->referenceWindows())
+    // Writes the session zip to device. Each entry is written as soon as it is added so the
+    // session is never held in memory as a whole.
+    // Images are stored once for each distinct content and the JSON of each reference names the entry
+    // its image is in, so references with identical images (e.g. duplicates or the same file added
+    // twice) share an entry.
+    // If state is given then device must contain the session file described by it. Only session.json
+    // and images that aren't already in the file are appended.
+    bool writeSessionZip(QIODevice *device,
+                         sessionSaving::SessionSnapshot &snapshot,
+                         SessionContents &contentsOut,
+                         const SessionFileState *state = nullptr)
+    {
+        utils::ZipFileWriter zipWriter;
+        if (!zipWriter.open(device, state != nullptr))
         {
-            for (const auto &refItem : refWindow->referenceImages())
+            return false;
+        }
+
+        // The entries already in the file (or written by this save) by their data. Avoids hashing shared data
+        // again.
+        QHash<const char *, QString> entryByData;
+        if (state)
+        {
+            for (auto it = state->contents.imageEntries.cbegin(); it != state->contents.imageEntries.cend(); ++it)
             {
-                if (shouldStoreRefItem(refItem))
+                entryByData.insert(it->constData(), it.key());
+            }
+        }
+
+        QJsonObject references = snapshot.json["references"].toObject();
+        for (auto &image : snapshot.images)
+        {
+            if (image.compressedData.isEmpty() && image.loading)
+            {
+                image.compressedData = loadingImageData(image);
+            }
+
+            QString entryName;
+            if (image.compressedData.isEmpty() && image.loading && state
+                && state->contents.imageEntries.contains(state->contents.referenceEntries.value(image.name)))
+            {
+                // Keep the data the image was last saved with
+                entryName = state->contents.referenceEntries.value(image.name);
+                contentsOut.imageEntries.insert(entryName, state->contents.imageEntries.value(entryName));
+                contentsOut.imageEntryOwners.insert(entryName, state->contents.imageEntryOwners.value(entryName));
+            }
+            else
+            {
+                if (image.compressedData.isEmpty() && !image.image.isNull())
+                {
+                    image.compressedData = utils::encodeImage(image.image, snapshot.codec);
+                }
+                if (image.compressedData.isEmpty())
                 {
-                    QByteArray itemData = refItem->ensureCompressedImage();
-                    // FIXME Ensure name is unique
-                    zipFile.addFile(refItem->name(), std::move(itemData));
+                    qWarning() << "Not saving" << image.name << "as it hasn't loaded yet";
+                    snapshot.skippedImages.push_back(image.name);
+                    continue;
+                }
+
+                entryName = entryByData.value(image.compressedData.constData());
+                if (entryName.isEmpty())
+                {
+                    entryName = imageEntryName(image);
+                    entryByData.insert(image.compressedData.constData(), entryName);
+                }
+
+                if (!contentsOut.imageEntries.contains(entryName))
+                {
+                    const bool inFile = state && state->contents.imageEntries.contains(entryName);
+                    if (!inFile && !zipWriter.addFile(entryName, image.compressedData))
+                    {
+                        qCritical() << "Unable to write" << image.name << "to the session file";
+                        return false;
+                    }
+                    contentsOut.imageEntries.insert(entryName, image.compressedData);
+                    contentsOut.imageEntryOwners.insert(entryName, image.compressedDataOwner);
                 }
             }
+
+            contentsOut.referenceEntries.insert(image.name, entryName);
+            QJsonObject refJson = references[image.name].toObject();
+            refJson["image"] = entryName;
+            references[image.name] = refJson;
+        }
+
+        // Written last as it names the image entries
+        QJsonObject json = snapshot.json;
+        json["references"] = references;
+        json["sessionFormat"] = sessionFormat;
+
+        const QByteArray jsonData = QJsonDocument(json).toJson();
+        if (!zipWriter.addFile(sessionJsonName, jsonData))
+        {
+            return false;
         }
+        contentsOut.sessionJsonSize = jsonData.size();
 
-        return zipFile.toBuffer();
+        return zipWriter.close();
     }
 
+    // Writes a complete session file replacing filepath
+    bool writeSessionFile(const QString &filepath,
+                          sessionSaving::SessionSnapshot &snapshot,
+                          SessionContents &contentsOut)
+    {
+        QSaveFile saveFile(filepath);
+        // Writing straight to a mapped file would truncate it under the images that refer to it
+        saveFile.setDirectWriteFallback(!isMappedSession(filepath));
+
+        if (!saveFile.open(QSaveFile::WriteOnly))
+        {
+            qCritical() << "Unable to open" << saveFile.fileName() << "for writing";
+            return false;
+        }
+
+        // Write errors are also caught by QSaveFile::commit
+        if (!writeSessionZip(&saveFile, snapshot, contentsOut))
+        {
+            qCritical() << "Error creating zip from session.";
+            saveFile.cancelWriting();
+            return false;
+        }
+
+        if (!saveFile.commit())
+        {
+            qCritical() << "Unable to save session to" << filepath;
+            return false;
+        }
+        return true;
+    }
+
+    // Flushes file's data to the disk so it isn't lost if the system crashes after saving
+    bool syncToDisk(QFile &file)
+    {
+        if (!file.flush())
+        {
+            return false;
+        }
+#ifdef Q_OS_WIN
+        return _commit(file.handle()) == 0;
+#else
+        return fsync(file.handle()) == 0;
+#endif // Q_OS_WIN
+    }
+
+    // Appends the changes to the session since it was last saved to filepath. The file's previous
+    // central directory is kept until the new one has been written (see ZipFileWriter::open) so the
+    // previous save can still be loaded if appending is interrupted. On failure the file must be
+    // completely rewritten.
+    bool appendToSession(const QString &filepath, sessionSaving::SessionSnapshot &snapshot)
+    {
+        SessionFileState &state = sessionFileState();
+
+        QFile file(filepath);
+        if (!file.open(QIODevice::ReadWrite))
+        {
+            qWarning() << "Unable to open" << filepath << "for appending";
+            return false;
+        }
+
+        const qint64 previousSize = file.size();
+        SessionContents contents;
+        if (!writeSessionZip(&file, snapshot, contents, &state) || !syncToDisk(file))
+        {
+            qWarning() << "Error appending to session file" << filepath;
+            // Remove the incomplete data so the file is the previous save again
+            file.resize(previousSize);
+            return false;
+        }
+        file.close();
+
+        state.reset(filepath, contents);
+        return true;
+    }
+
+    // If zipReader's file is kept mapped then it's kept open by the loaded images (see keepSessionsMapped)
     bool loadReferenceItems(const QJsonDocument &doc,
-                            const utils::ZipFile &zipFile,
-                            QList<ReferenceImageSP> &newItemsOut)
+                            const std::shared_ptr<const utils::ZipFileReader> &zipReader,
+                            QList<ReferenceImageSP> &newItemsOut,
+                            SessionContents &contentsOut)
     {
         const QJsonObject docObj = doc.object();
 
@@ -128,20 +499,44 @@ namespace
             return false;
         }
 
-        QMap<QString, QByteArray> imageDataMap;
+        const std::shared_ptr<const void> imageDataOwner = keepSessionsMapped ? zipReader : nullptr;
+
+        // Older sessions store each image in an entry named after its reference
+        const bool namedEntries = docObj["sessionFormat"].toInt(1) < sessionFormat;
 
-        for (const auto &refName : references.keys())
+        QMap<QString, QByteArray> imageData;
+        for (auto it = references.constBegin(); it != references.constEnd(); ++it)
         {
-            const QByteArray &imgData = zipFile.getFile(refName);
+            const QString entryName = namedEntries ? it.key() : it->toObject()["image"].toString();
+            if (entryName.isEmpty())
+            {
+                continue; // Not stored in the session (e.g. linked copies and linked files)
+            }
+
+            // References with identical images share the entry's data
+            QByteArray imgData = contentsOut.imageEntries.value(entryName);
+            if (imgData.isEmpty())
+            {
+                imgData = zipReader->getFile(entryName);
+                if (!keepSessionsMapped)
+                {
+                    // The image data is kept by the ReferenceImage after loading so it must be copied
+                    // out of the memory mapped session file.
+                    imgData.detach();
+                }
+            }
 
             if (!imgData.isEmpty())
             {
-                imageDataMap.insert(refName, imgData);
+                imageData.insert(it.key(), imgData);
+                contentsOut.imageEntries.insert(entryName, imgData);
+                contentsOut.imageEntryOwners.insert(entryName, imageDataOwner);
+                contentsOut.referenceEntries.insert(it.key(), entryName);
             }
         }
 
         App *app = App::ghostRefInstance();
-        newItemsOut.append(std::move(app->referenceItems()->loadJson(references, imageDataMap)));
+        newItemsOut.append(std::move(app->referenceItems()->loadJson(references, imageData, imageDataOwner)));
         return true;
     }
 
@@ -196,11 +591,11 @@ namespace
         return false;
     }
 
-    bool loadSessionFromZip(QByteArray &zipBuffer)
+    // contentsOut is set to the entries used by the session
+    bool loadSessionFromZip(const std::shared_ptr<const utils::ZipFileReader> &zipReader,
+                            SessionContents &contentsOut)
     {
-        const utils::ZipFile zipFile = utils::ZipFile::fromBuffer(zipBuffer);
-
-        const QByteArray &sessionJson = zipFile.getFile(sessionJsonName);
+        const QByteArray sessionJson = zipReader->getFile(sessionJsonName);
 
         if (sessionJson.isEmpty())
         {
@@ -224,13 +619,23 @@ namespace
             return false;
         }
 
+        if (const int format = jsonDoc["sessionFormat"].toInt(1); format > sessionFormat)
+        {
+            qCritical() << "Session file has session format" << format
+                        << "which is from a newer version of Ghost Reference. Update it to load the session.";
+            return false;
+        }
+
         App::ghostRefInstance()->newSession(true);
 
         loadToolbarPos(jsonDoc);
 
+        // Images are decoded in parallel in the global thread pool. The reference windows are shown
+        // straight away (displaying placeholders) and update as each image finishes loading.
         // Need to keep the shared pointers to prevent the ReferenceImages from being destroyed
         QList<ReferenceImageSP> refItems;
-        if (!loadReferenceItems(jsonDoc, zipFile, refItems))
+        contentsOut.sessionJsonSize = sessionJson.size();
+        if (!loadReferenceItems(jsonDoc, zipReader, refItems, contentsOut))
         {
             return false;
         }
@@ -262,64 +667,128 @@ namespace sessionSaving
         return QJsonDocument(json);
     }
 
-    bool saveSession(const QString &filepath)
+    SessionSnapshot takeSnapshot(bool compressImages)
     {
-        const QByteArray sessionZip = createSessionZip();
-        if (sessionZip.isEmpty())
+        const App *app = App::ghostRefInstance();
+
+        QList<ReferenceImageSP> refItems;
+        for (const auto &refWindow : app->referenceWindows())
         {
-            qCritical() << "Error creating zip from session.";
-            return false;
+            for (const auto &refItem : refWindow->referenceImages())
+            {
+                if (shouldStoreRefItem(refItem))
+                {
+                    refItems.push_back(refItem);
+                }
+            }
         }
 
-        QSaveFile saveFile(filepath);
-        saveFile.setDirectWriteFallback(true);
+        if (compressImages)
+        {
+            compressInParallel(refItems);
+        }
 
-        if (!saveFile.open(QSaveFile::WriteOnly))
+        SessionSnapshot snapshot;
+        snapshot.json = sessionToJson().object();
+        snapshot.codec = ReferenceImage::storedImageCodec();
+
+        for (const auto &refItem : refItems)
         {
-            qCritical() << "Unable to open" << saveFile.fileName() << "for writing";
-            return false;
+            SessionSnapshot::Image image{refItem->name(), refItem.toWeakRef(), refItem->compressedImage(),
+                                         refItem->compressedImageOwner(), refItem->compressedImageHash(),
+                                         refItem->baseImage(), refItem->isLoading()};
+            if (image.compressedData.isEmpty() && image.loading)
+            {
+                const RefImageLoaderUP &loader = refItem->loader();
+                image.compressedData = loader->fileData();
+                image.compressedDataOwner = loader->fileDataOwner();
+                image.compressedDataHash = loader->fileDataHash();
+                image.loadingFile = refItem->filepath();
+                image.download = loader->downloadFuture();
+            }
+            snapshot.images.push_back(std::move(image));
         }
+        return snapshot;
+    }
 
-        QDataStream dataStream(&saveFile);
-        dataStream.writeRawData(sessionZip.constData(), static_cast<int>(sessionZip.size()));
+    bool writeSnapshot(SessionSnapshot &snapshot, const QString &filepath)
+    {
+        SessionContents contents;
+        return writeSessionFile(filepath, snapshot, contents);
+    }
 
-        if (!saveFile.commit())
+    bool saveSession(const QString &filepath, bool incremental, bool *complete)
+    {
+        SessionSnapshot snapshot = takeSnapshot();
+
+        if (incremental && sessionFileState().canAppendTo(filepath))
+        {
+            if (appendToSession(filepath, snapshot))
+            {
+                qInfo() << "Session saved incrementally as" << QFileInfo(filepath).absoluteFilePath();
+                if (complete)
+                {
+                    *complete = snapshot.skippedImages.isEmpty();
+                }
+                return true;
+            }
+            snapshot.skippedImages.clear();
+            qWarning() << "Incremental save failed. Rewriting" << filepath;
+        }
+
+        SessionContents contents;
+        if (!writeSessionFile(filepath, snapshot, contents))
         {
-            qCritical() << "Unable to save session to" << filepath;
             return false;
         }
 
-        qInfo() << "Session saved as" << QFileInfo(saveFile).absoluteFilePath();
+        sessionFileState().reset(filepath, contents);
+        qInfo() << "Session saved as" << QFileInfo(filepath).absoluteFilePath();
+        if (complete)
+        {
+            *complete = snapshot.skippedImages.isEmpty();
+        }
         return true;
     }
 
     bool loadSession(const QString &filepath)
     {
-        QFile file(filepath);
-        if (!file.open(QFile::ReadOnly))
+        // Only the zip's central directory is read here. Entries are read from the memory mapped
+        // file as they are needed.
+        auto zipReader = std::make_shared<utils::ZipFileReader>();
+        if (!zipReader->open(filepath))
         {
             qCritical() << "Unable to open file" << filepath;
             return false;
         }
-        const QFileInfo fileInfo(file);
-        if (fileInfo.size() > std::numeric_limits<int32_t>::max())
+
+        SessionContents contents;
+        const bool loaded = loadSessionFromZip(zipReader, contents);
+        if (keepSessionsMapped && !contents.imageEntries.isEmpty())
         {
-            qCritical() << "Cannot load Session file" << filepath << "File is too large";
-            return false;
+            // Images loaded before an error still refer to the file
+            addMappedSession(filepath, zipReader);
         }
-
-        QByteArray buf = file.readAll();
-
-        if (!loadSessionFromZip(buf))
+        if (!loaded)
         {
             qCritical() << "Unable to load session from " << filepath;
             return false;
         }
 
-        qInfo() << "Loaded session" << fileInfo.absoluteFilePath();
+        // The loaded images are shared with the ReferenceImages so an incremental save can tell which
+        // images are unchanged.
+        sessionFileState().reset(filepath, contents);
+
+        qInfo() << "Loaded session" << QFileInfo(filepath).absoluteFilePath();
         return true;
     }
 
+    void closeSession()
+    {
+        // Releases the session file's data so it's unmapped once nothing else uses it
+        sessionFileState().reset({}, {});
+    }
+
     QString showSaveAsDialog(const QString &directory)
     {
         return QFileDialog::getSaveFileName(nullptr, "Save Ghost Reference Session",
@@ -4,15 +4,64 @@ class QDropEvent;
 class QJsonDocument;
 class QString;
 
+#include <memory>
+
+#include <QtCore/QFuture>
+#include <QtCore/QJsonObject>
+#include <QtCore/QList>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtGui/QImage>
+
+#include "types.h"
+#include "utils/image.h"
 
 namespace sessionSaving
 {
+    // A copy of the session that can be written to a file from any thread. Taking a snapshot is cheap
+    // as the JSON and image data are implicitly shared with the session.
+    struct SessionSnapshot
+    {
+        struct Image
+        {
+            QString name;
+            ReferenceImageWP refItem;
+            QByteArray compressedData; // Empty if the image hasn't been compressed yet
+            std::shared_ptr<const void> compressedDataOwner; // See ReferenceImage::compressedImageOwner
+            QByteArray compressedDataHash;                   // See ReferenceImage::compressedImageHash
+            QImage image;
+            bool loading = false;
+            // Where the data of an image that is still loading comes from. Read when the snapshot is written.
+            QString loadingFile;
+            QFuture<QByteArray> download;
+        };
+
+        QJsonObject json;
+        QList<Image> images;
+        // Used to compress images that weren't compressed when the snapshot was taken
+        utils::ImageCodec codec;
+        // Names of the images that weren't written because they hadn't loaded yet. Set by writeSnapshot.
+        QStringList skippedImages;
+    };
 
     QJsonDocument sessionToJson();
-    bool saveSession(const QString &filepath);
+
+    // Must be called from the GUI thread. If compressImages is true then images that haven't been
+    // compressed yet are compressed in parallel in the global thread pool (and cached by their
+    // ReferenceImage) while the GUI thread waits. Otherwise they're left for writeSnapshot to compress.
+    SessionSnapshot takeSnapshot(bool compressImages = true);
+    // Writes snapshot as a session file to filepath. Can be called from any thread. Images that
+    // weren't compressed when the snapshot was taken are compressed and stored in snapshot.
+    bool writeSnapshot(SessionSnapshot &snapshot, const QString &filepath);
+    // Saves the session to filepath. If incremental is true and filepath is the session file that was
+    // last saved or loaded then only session.json and new or changed images are appended to it.
+    // If complete isn't null then it's set to false if any images weren't saved because they're still loading
+    // (e.g. downloads in progress).
+    bool saveSession(const QString &filepath, bool incremental = false, bool *complete = nullptr);
 
     bool loadSession(const QString &filepath);
+    // Forgets the session file that was last saved or loaded. Called when a new session is started.
+    void closeSession();
 
     QString showSaveAsDialog(const QString &directory = {});
     QString showOpenDialog(const QString &directory = {}, bool sessions = true, bool references = true);
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <QtCore/QBuffer>
+#include <QtGui/QColor>
+#include <QtGui/QImage>
+
+#include "../utils/image_cache.h"
+
+namespace
+{
+    QByteArray pngData(const QColor &color)
+    {
+        QImage image(64, 32, QImage::Format_RGB32);
+        image.fill(color);
+
+        QByteArray data;
+        QBuffer buffer(&data);
+        image.save(&buffer, "PNG");
+        return data;
+    }
+} // namespace
+
+TEST(ImageCacheTests, SharesIdenticalFileData)
+{
+    utils::ImageCache cache;
+    const QByteArray redData = pngData(Qt::red);
+
+    const utils::ImageCache::EntrySP first = cache.decode(redData);
+    ASSERT_TRUE(first);
+    EXPECT_EQ(first->image.pixelColor(10, 10), QColor(Qt::red));
+
+    // An identical copy of the file data decodes to the same entry
+    const utils::ImageCache::EntrySP second = cache.decode(QByteArray(redData.constData(), redData.size()));
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(first->image.cacheKey(), second->image.cacheKey());
+
+    const utils::ImageCache::EntrySP blue = cache.decode(pngData(Qt::blue));
+    ASSERT_TRUE(blue);
+    EXPECT_NE(blue, first);
+    EXPECT_EQ(cache.size(), 2);
+
+    EXPECT_FALSE(cache.decode(QByteArray("not an image")));
+}
+
+TEST(ImageCacheTests, EntriesExpireWhenUnused)
+{
+    utils::ImageCache cache;
+    const QByteArray data = pngData(Qt::green);
+    const QByteArray hash = utils::ImageCache::contentHash(data);
+
+    utils::ImageCache::EntrySP entry = cache.decode(data);
+    EXPECT_EQ(cache.find(hash), entry);
+
+    entry.reset();
+    EXPECT_FALSE(cache.find(hash));
+    EXPECT_EQ(cache.size(), 0);
+
+    // Inserting an already cached entry returns the existing one
+    entry = cache.decode(data);
+    EXPECT_EQ(cache.insert(hash, data, QImage(8, 8, QImage::Format_RGB32)), entry);
+}
+
+TEST(ImageCacheTests, UsesKnownHash)
+{
+    utils::ImageCache cache;
+    const QByteArray data = pngData(Qt::yellow);
+    const QByteArray hash = utils::ImageCache::contentHash(data);
+
+    const utils::ImageCache::EntrySP entry = cache.decode(data);
+    ASSERT_TRUE(entry);
+    EXPECT_EQ(entry->hash, hash);
+    // Decoding with the hash finds the entry without hashing the data again
+    EXPECT_EQ(cache.decode(data, {}, hash), entry);
+}
+
+TEST(ImageCacheTests, RemovesExpiredEntries)
+{
+    utils::ImageCache cache;
+    const QImage image(8, 8, QImage::Format_RGB32);
+    for (int i = 0; i < 1000; ++i)
+    {
+        // Each entry expires straight away
+        cache.insert(QByteArray::number(i), QByteArray::number(i), image);
+    }
+    const utils::ImageCache::EntrySP entry = cache.insert("kept", "kept", image);
+    EXPECT_EQ(cache.size(), 1);
+    EXPECT_EQ(cache.find("kept"), entry);
+    EXPECT_FALSE(cache.find(QByteArray::number(0)));
+}
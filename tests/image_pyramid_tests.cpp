@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <QtGui/QColor>
+#include <QtGui/QImage>
+
+#include "../utils/image.h"
+#include "../utils/image_pyramid.h"
+
+namespace
+{
+    QImage solidImage(QSize size, const QColor &color)
+    {
+        QImage image(size, QImage::Format_RGB32);
+        image.fill(color);
+        return image;
+    }
+} // namespace
+
+TEST(ImagePyramidTests, TileAlignedRect)
+{
+    const int tileSize = utils::ImagePyramid::tileSize;
+    const utils::ImagePyramid pyramid(solidImage({3000, 2000}, Qt::red));
+
+    EXPECT_EQ(pyramid.tileAlignedRect({10, 10, 20, 20}, 1.0), QRect(0, 0, tileSize, tileSize));
+    EXPECT_EQ(pyramid.tileAlignedRect({tileSize, 0, 1, tileSize + 1}, 1.0), QRect(tileSize, 0, tileSize, tileSize * 2));
+    // Clamped to the scaled image
+    EXPECT_EQ(pyramid.tileAlignedRect({-100, -100, 5000, 5000}, 0.5), QRect(0, 0, 1500, 1000));
+    EXPECT_TRUE(pyramid.tileAlignedRect({4000, 0, 10, 10}, 1.0).isEmpty());
+}
+
+TEST(ImagePyramidTests, RenderRegion)
+{
+    QImage image = solidImage({4000, 3000}, Qt::blue);
+    image.setPixelColor(3999, 2999, Qt::green);
+    utils::ImagePyramid pyramid(image);
+
+    const QImage full = pyramid.render({0, 0, 4000, 3000}, 1.0);
+    EXPECT_EQ(full.size(), QSize(4000, 3000));
+    EXPECT_EQ(full.cacheKey(), image.cacheKey()); // Unscaled and uncropped images aren't copied
+
+    const QImage region = pyramid.render({1000, 500, 700, 600}, 0.3);
+    EXPECT_EQ(region.size(), QSize(200, 400)); // Clamped to the 1200 * 900 scaled image
+    EXPECT_EQ(region.pixelColor(0, 0), QColor(Qt::blue));
+    EXPECT_EQ(region.pixelColor(100, 200), QColor(Qt::blue));
+
+    const QImage corner = pyramid.render({3990, 2990, 10, 10}, 1.0);
+    EXPECT_EQ(corner.pixelColor(9, 9), QColor(Qt::green));
+
+    EXPECT_TRUE(pyramid.render({5000, 0, 10, 10}, 1.0).isNull());
+}
+
+TEST(ImagePyramidTests, SetImageClearsTiles)
+{
+    utils::ImagePyramid pyramid(solidImage({2000, 2000}, Qt::red));
+    EXPECT_EQ(pyramid.render({0, 0, 100, 100}, 0.25).pixelColor(50, 50), QColor(Qt::red));
+
+    const QImage yellow = solidImage({2000, 2000}, Qt::yellow);
+    EXPECT_TRUE(pyramid.setImage(yellow));
+    EXPECT_FALSE(pyramid.setImage(yellow));
+    EXPECT_EQ(pyramid.render({0, 0, 100, 100}, 0.25).pixelColor(50, 50), QColor(Qt::yellow));
+}
+
+TEST(ImagePyramidTests, RenderEffects)
+{
+    QImage image(1500, 1200, QImage::Format_ARGB32);
+    for (int y = 0; y < image.height(); y++)
+    {
+        for (int x = 0; x < image.width(); x++)
+        {
+            image.setPixel(x, y, qRgba(x % 256, y % 256, (x + y) % 256, 255));
+        }
+    }
+    utils::ImagePyramid pyramid(image);
+
+    utils::ImageEffects effects;
+    effects.flipHorizontal = true;
+    effects.flipVertical = true;
+    effects.saturation = 0.4;
+
+    for (const qreal scale : {1.0, 0.7})
+    {
+        const QRect region(300, 200, 800, 700);
+        QImage expected = pyramid.render(region, scale).mirrored(true, true);
+        utils::reduceSaturation(expected, effects.saturation);
+
+        QImage target;
+        pyramid.render(region, scale, target, effects);
+        EXPECT_EQ(target, expected) << "scale " << scale;
+
+        // The target's pixels are reused when rendering again
+        const uchar *bits = target.constBits();
+        pyramid.render(region, scale, target, effects);
+        EXPECT_EQ(target.constBits(), bits);
+    }
+}
+
+TEST(ImagePyramidTests, CacheBytes)
+{
+    // Images in the render format are shared instead of converted
+    utils::ImagePyramid pyramid(solidImage({2000, 2000}, Qt::red));
+    EXPECT_EQ(pyramid.cacheBytes(), 0);
+
+    pyramid.render({0, 0, 300, 300}, 0.3);
+    EXPECT_GT(pyramid.cacheBytes(), 0);
+
+    QImage argbImage(1000, 1000, QImage::Format_ARGB32);
+    argbImage.fill(Qt::blue);
+    pyramid.setImage(argbImage);
+    EXPECT_EQ(pyramid.image().format(), QImage::Format_ARGB32_Premultiplied);
+    EXPECT_EQ(pyramid.cacheBytes(), pyramid.image().sizeInBytes());
+
+    // Decoded images are converted to the render format so the pyramid can share them
+    utils::convertToRenderFormat(argbImage);
+    pyramid.setImage(argbImage);
+    EXPECT_EQ(pyramid.cacheBytes(), 0);
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <QtCore/QRandomGenerator>
+#include <QtGui/QImage>
+
+#include "../utils/image.h"
+
+namespace
+{
+    // Odd width so the kernels' scalar tails are also tested
+    QImage randomImage(QImage::Format format)
+    {
+        QImage image(67, 13, format);
+        QRandomGenerator rng(7);
+        for (int y = 0; y < image.height(); y++)
+        {
+            auto *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < image.width(); x++)
+            {
+                const QRgb rgb = rng.generate();
+                line[x] = format == QImage::Format_ARGB32_Premultiplied ? qPremultiply(rgb) : rgb;
+            }
+        }
+        return image;
+    }
+} // namespace
+
+TEST(ImageTests, ReduceSaturation)
+{
+    QImage image(2, 1, QImage::Format_RGB32);
+    image.setPixel(0, 0, qRgb(200, 100, 50));
+    image.setPixel(1, 0, qRgb(10, 20, 30));
+
+    QImage gray = image.copy();
+    utils::reduceSaturation(gray, 0.0);
+    EXPECT_EQ(gray.pixel(0, 0), qRgb(200, 200, 200));
+    EXPECT_EQ(gray.pixel(1, 0), qRgb(30, 30, 30));
+
+    QImage unchanged = image.copy();
+    utils::reduceSaturation(unchanged, 1.0);
+    EXPECT_EQ(unchanged, image);
+
+    QImage half = image.copy();
+    utils::reduceSaturation(half, 0.5);
+    EXPECT_EQ(half.pixel(0, 0), qRgb(200, 150, 125));
+}
+
+TEST(ImageTests, ReduceSaturationSimdMatchesScalar)
+{
+    using utils::SimdLevel;
+    const auto formats = {QImage::Format_RGB32, QImage::Format_ARGB32, QImage::Format_ARGB32_Premultiplied};
+    for (const QImage::Format format : formats)
+    {
+        const QImage image = randomImage(format);
+        for (const qreal saturation : {0.0, 0.3, 0.75})
+        {
+            QImage expected = image.copy();
+            utils::reduceSaturation(expected, saturation, SimdLevel::Scalar);
+
+            for (const SimdLevel simdLevel : {SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::NEON})
+            {
+                if (!utils::isSimdLevelSupported(simdLevel)) continue;
+
+                QImage result = image.copy();
+                utils::reduceSaturation(result, saturation, simdLevel);
+                EXPECT_EQ(result, expected)
+                    << "SimdLevel " << static_cast<int>(simdLevel) << " saturation " << saturation;
+            }
+        }
+    }
+}
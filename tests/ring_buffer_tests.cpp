@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "../utils/ring_buffer.h"
+
+TEST(RingBufferTests, PushAndPop)
+{
+    utils::RingBuffer<int> buffer(3);
+    EXPECT_TRUE(buffer.isEmpty());
+
+    for (int i = 1; i <= 5; i++)
+    {
+        buffer.pushBack(int(i));
+    }
+    // Pushing to a full buffer removes the oldest element
+    ASSERT_EQ(buffer.size(), 3);
+    EXPECT_TRUE(buffer.isFull());
+    EXPECT_EQ(buffer[0], 3);
+    EXPECT_EQ(buffer[1], 4);
+    EXPECT_EQ(buffer[2], 5);
+
+    buffer.popBack();
+    buffer.popFront();
+    ASSERT_EQ(buffer.size(), 1);
+    EXPECT_EQ(buffer.front(), 4);
+    EXPECT_EQ(buffer.back(), 4);
+
+    buffer.pushBack(6);
+    buffer.pushBack(7);
+    EXPECT_EQ(buffer[0], 4);
+    EXPECT_EQ(buffer[2], 7);
+
+    buffer.clear();
+    EXPECT_TRUE(buffer.isEmpty());
+}
+
+TEST(RingBufferTests, SetCapacityKeepsNewest)
+{
+    utils::RingBuffer<std::unique_ptr<int>> buffer(4);
+    for (int i = 0; i < 6; i++)
+    {
+        buffer.pushBack(std::make_unique<int>(i));
+    }
+
+    buffer.setCapacity(2);
+    ASSERT_EQ(buffer.size(), 2);
+    EXPECT_EQ(*buffer[0], 4);
+    EXPECT_EQ(*buffer[1], 5);
+
+    buffer.setCapacity(8);
+    buffer.pushBack(std::make_unique<int>(6));
+    ASSERT_EQ(buffer.size(), 3);
+    EXPECT_EQ(*buffer.back(), 6);
+
+    // A buffer with no capacity stays empty
+    buffer.setCapacity(0);
+    buffer.pushBack(std::make_unique<int>(7));
+    EXPECT_TRUE(buffer.isEmpty());
+}
@@ -127,6 +127,21 @@ TEST_F(PreferencesTests, FloatProperty)
     EXPECT_DOUBLE_EQ(prefs().getFloat(prop), range.min);
 }
 
+TEST_F(PreferencesTests, EnumProperty)
+{
+    const auto prop = Preferences::StoredImageFormat;
+    EXPECT_TRUE(prefs().getType(prop) == QMetaType::QString);
+    ASSERT_GT(Preferences::getEnumCount(prop), 1);
+
+    const PrefEnumItem &secondItem = Preferences::getEnumItem(prop, 1);
+    prefs().setString(prop, secondItem.identifier);
+    EXPECT_EQ(prefs().getEnumItem(prop).identifier, secondItem.identifier);
+
+    // Invalid values use the first item
+    prefs().setString(prop, "invalid");
+    EXPECT_EQ(prefs().getEnumItem(prop).identifier, Preferences::getEnumItem(prop, 0).identifier);
+}
+
 TEST_F(PreferencesTests, JsonSaveLoad)
 {
     QJsonDocument json = prefs().toJsonDocument();
@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include <QtCore/QTemporaryFile>
+
+#include "../utils/zip_file.h"
+
+namespace
+{
+    // Writes zipFile to tempFile. Returns false on failure.
+    bool writeToTempFile(utils::ZipFile &zipFile, QTemporaryFile &tempFile)
+    {
+        if (!tempFile.open())
+        {
+            return false;
+        }
+        const QByteArray buffer = zipFile.toBuffer();
+        const bool success = tempFile.write(buffer) == buffer.size();
+        tempFile.close();
+        return success;
+    }
+} // namespace
+
+TEST(ZipFileTests, ReplaceAndLookUpEntries)
+{
+    utils::ZipFile zipFile;
+    zipFile.addFile("first.txt", QByteArray("1"));
+    zipFile.addFile("dir//second.txt", QByteArray("2"));
+    zipFile.addFile("./first.txt", QByteArray("3")); // Replaces the first entry keeping its position
+
+    EXPECT_TRUE(zipFile.hasFile("dir/second.txt"));
+    EXPECT_TRUE(zipFile.hasFile("dir/../dir/second.txt"));
+    EXPECT_FALSE(zipFile.hasFile("second.txt"));
+    EXPECT_EQ(zipFile.getFile("first.txt"), QByteArray("3"));
+    EXPECT_TRUE(zipFile.getFile("missing.txt").isEmpty());
+
+    QTemporaryFile tempFile;
+    ASSERT_TRUE(writeToTempFile(zipFile, tempFile));
+
+    utils::ZipFileReader zipReader;
+    ASSERT_TRUE(zipReader.open(tempFile.fileName()));
+    EXPECT_EQ(zipReader.filenames(), QList<QString>({"first.txt", "dir/second.txt"}));
+}
+
+TEST(ZipFileReaderTests, ReadEntries)
+{
+    const QByteArray smallData("Hello");
+    const QByteArray largeData(100000, 'x');
+
+    utils::ZipFile zipFile;
+    zipFile.addFile("small.txt", smallData);
+    zipFile.addFile("dir/large.bin", largeData);
+
+    QTemporaryFile tempFile;
+    ASSERT_TRUE(writeToTempFile(zipFile, tempFile));
+
+    utils::ZipFileReader zipReader;
+    ASSERT_TRUE(zipReader.open(tempFile.fileName()));
+
+    EXPECT_EQ(zipReader.filenames(), QList<QString>({"small.txt", "dir/large.bin"}));
+    EXPECT_TRUE(zipReader.hasFile("./small.txt"));
+    EXPECT_FALSE(zipReader.hasFile("missing.txt"));
+
+    EXPECT_EQ(zipReader.getFile("small.txt"), smallData);
+    EXPECT_EQ(zipReader.getFile("dir/large.bin"), largeData);
+    EXPECT_TRUE(zipReader.getFile("missing.txt").isEmpty());
+
+    zipReader.close();
+    EXPECT_FALSE(zipReader.isOpen());
+    EXPECT_FALSE(zipReader.hasFile("small.txt"));
+}
+
+TEST(ZipFileReaderTests, OpenInvalid)
+{
+    QTemporaryFile tempFile;
+    ASSERT_TRUE(tempFile.open());
+    tempFile.write("Not a zip file");
+    tempFile.close();
+
+    utils::ZipFileReader zipReader;
+    EXPECT_FALSE(zipReader.open(tempFile.fileName()));
+    EXPECT_FALSE(zipReader.isOpen());
+}
+
+TEST(ZipFileWriterTests, WriteToFile)
+{
+    const QByteArray data1("First entry");
+    const QByteArray data2(3 << 20, 'y'); // Larger than the chunk size used when writing
+
+    QTemporaryFile tempFile;
+    ASSERT_TRUE(tempFile.open());
+
+    utils::ZipFileWriter zipWriter;
+    ASSERT_TRUE(zipWriter.open(&tempFile));
+    EXPECT_TRUE(zipWriter.addFile("first.txt", data1));
+    EXPECT_TRUE(zipWriter.addFile("dir/second.bin", data2));
+    EXPECT_FALSE(zipWriter.addFile("./first.txt", data2)); // Duplicate
+    ASSERT_TRUE(zipWriter.close());
+    EXPECT_FALSE(zipWriter.isOpen());
+    tempFile.close();
+
+    utils::ZipFileReader zipReader;
+    ASSERT_TRUE(zipReader.open(tempFile.fileName()));
+
+    EXPECT_EQ(zipReader.filenames(), QList<QString>({"first.txt", "dir/second.bin"}));
+    EXPECT_EQ(zipReader.getFile("first.txt"), data1);
+    EXPECT_EQ(zipReader.getFile("dir/second.bin"), data2);
+}
+
+TEST(ZipFileWriterTests, AppendToFile)
+{
+    QTemporaryFile tempFile;
+    ASSERT_TRUE(tempFile.open());
+    {
+        utils::ZipFileWriter zipWriter;
+        ASSERT_TRUE(zipWriter.open(&tempFile));
+        ASSERT_TRUE(zipWriter.addFile("session.json", "old"));
+        ASSERT_TRUE(zipWriter.addFile("image.png", "image data"));
+        ASSERT_TRUE(zipWriter.close());
+    }
+    {
+        utils::ZipFileWriter zipWriter;
+        ASSERT_TRUE(zipWriter.open(&tempFile, true));
+        ASSERT_TRUE(zipWriter.addFile("session.json", "new"));
+        ASSERT_TRUE(zipWriter.addFile("image2.png", "more image data"));
+        ASSERT_TRUE(zipWriter.close());
+    }
+    tempFile.close();
+
+    utils::ZipFileReader zipReader;
+    ASSERT_TRUE(zipReader.open(tempFile.fileName()));
+
+    EXPECT_EQ(zipReader.filenames(), QList<QString>({"session.json", "image.png", "image2.png"}));
+    EXPECT_EQ(zipReader.getFile("session.json"), QByteArray("new"));
+    EXPECT_EQ(zipReader.getFile("image.png"), QByteArray("image data"));
+    EXPECT_EQ(zipReader.getFile("image2.png"), QByteArray("more image data"));
+}
+
+TEST(ZipFileWriterTests, InterruptedAppendKeepsOldEntries)
+{
+    QTemporaryFile tempFile;
+    ASSERT_TRUE(tempFile.open());
+    {
+        utils::ZipFileWriter zipWriter;
+        ASSERT_TRUE(zipWriter.open(&tempFile));
+        ASSERT_TRUE(zipWriter.addFile("session.json", "old"));
+        ASSERT_TRUE(zipWriter.close());
+    }
+    const qint64 originalSize = tempFile.size();
+    {
+        utils::ZipFileWriter zipWriter;
+        ASSERT_TRUE(zipWriter.open(&tempFile, true));
+        // Much more than the 64KB at the end of the file that minizip searches for the end of central directory
+        ASSERT_TRUE(zipWriter.addFile("image.png", QByteArray(1 << 20, 'i')));
+        ASSERT_TRUE(zipWriter.addFile("session.json", "new"));
+        ASSERT_TRUE(zipWriter.close());
+    }
+
+    // Simulate the append being interrupted before its end of central directory record was written
+    ASSERT_TRUE(tempFile.seek(0));
+    const QByteArray appended = tempFile.readAll();
+    tempFile.close();
+    ASSERT_GT(appended.size(), originalSize);
+
+    QTemporaryFile truncatedFile;
+    ASSERT_TRUE(truncatedFile.open());
+    truncatedFile.write(appended.left(appended.size() - 22)); // Minimum end of central directory record size
+    truncatedFile.close();
+
+    utils::ZipFileReader zipReader;
+    ASSERT_TRUE(zipReader.open(truncatedFile.fileName()));
+    EXPECT_EQ(zipReader.filenames(), QList<QString>({"session.json"}));
+    EXPECT_EQ(zipReader.getFile("session.json"), QByteArray("old"));
+}
+
+// Writes and reads back a 5GB zip file so Zip64 offsets are needed. Disabled by default as it needs
+// around 2GB of memory and 5GB of disk space. Run with --gtest_also_run_disabled_tests
+TEST(ZipFileWriterTests, DISABLED_Zip64LargeFile)
+{
+    const qsizetype entrySize = 1700LL << 20;
+    const int entryCount = 3;
+
+    QByteArray data(entrySize, 'z');
+    data[0] = 'a';
+    data[entrySize - 1] = 'b';
+
+    QTemporaryFile tempFile;
+    ASSERT_TRUE(tempFile.open());
+    {
+        utils::ZipFileWriter zipWriter;
+        ASSERT_TRUE(zipWriter.open(&tempFile));
+        ASSERT_TRUE(zipWriter.addFile("session.json", "{}"));
+        for (int i = 0; i < entryCount; ++i)
+        {
+            ASSERT_TRUE(zipWriter.addFile(QString("image%1.png").arg(i), data));
+        }
+        ASSERT_TRUE(zipWriter.close());
+    }
+    EXPECT_GT(tempFile.size(), 5LL * 1000 * 1000 * 1000);
+    tempFile.close();
+
+    utils::ZipFileReader zipReader;
+    ASSERT_TRUE(zipReader.open(tempFile.fileName()));
+    ASSERT_EQ(zipReader.filenames().size(), entryCount + 1);
+    EXPECT_EQ(zipReader.getFile("session.json"), QByteArray("{}"));
+
+    for (int i = 0; i < entryCount; ++i)
+    {
+        // Compare in place so the stored entries aren't copied out of the mapped file
+        const QByteArray entry = zipReader.getFile(QString("image%1.png").arg(i));
+        EXPECT_TRUE(entry == data) << "image" << i << "differs";
+    }
+}
@@ -19,6 +19,8 @@
 #include "../widgets/picture_widget.h"
 #include "../widgets/reference_window.h"
 
+#include "../utils/image.h"
+
 // Use static members to save options between activations until a save/load state function
 // is implemented in Tool
 bool ColorPicker::s_useOriginal = false;
@@ -195,8 +197,13 @@ namespace
     {
         if (const ReferenceImageSP &refImage = widget->image(); refImage)
         {
+            if (refImage->isDownsampled())
+            {
+                // Picks from the downsampled image until the full image is decoded
+                refImage->decodeFullImage();
+            }
             const QImage baseImage = refImage->baseImage();
-            const QPointF imgPos = widget->localToBaseImage(localPos);
+            const QPointF imgPos = widget->localToBaseImage(localPos) * refImage->baseImageScale();
 
             if (baseImage.rect().toRectF().contains(imgPos))
             {
@@ -215,12 +222,18 @@ namespace
         if (const ReferenceImageSP &refImage = widget->image(); refImage)
         {
             auto lock = refImage->lockDisplayImage();
-            const QPixmap &pixmap = refImage->displayImage();
+            const QImage &displayImage = refImage->displayImage();
             const QPointF imgPos = widget->localToDisplayImage(localPos);
 
-            if (pixmap.rect().toRectF().contains(imgPos))
+            if (displayImage.rect().toRectF().contains(imgPos))
             {
-                const QImage pick = pixmap.copy(qFloor(imgPos.x()), qFloor(imgPos.y()), 1, 1).toImage();
+                QImage pick = displayImage.copy(qFloor(imgPos.x()), qFloor(imgPos.y()), 1, 1);
+                if (const qreal saturation = refImage->paintEffects().saturation; saturation < 1.0 && !pick.isNull())
+                {
+                    // The saturation is applied when painting the display image
+                    pick.convertTo(QImage::Format_ARGB32);
+                    utils::reduceSaturation(pick, saturation);
+                }
                 return pick.isNull() ? QColor() : pick.pixelColor(0, 0);
             }
         }
@@ -7,13 +7,16 @@
 #endif // !GHOST_REF_VERSION_MAJOR
 
 class App;
+class Autosave;
 class GlobalHotkeys;
 class Logger;
+class MemoryBudget;
 class Preferences;
 class ReferenceCollection;
 class ReferenceImage;
 class RefLoader;
 class RefImageLoader;
+class RedrawScheduler;
 class SystemTrayIcon;
 class UndoStack;
 
@@ -36,8 +39,10 @@ class TabBar;
 // utils
 namespace utils
 {
+    struct ImageCodec;
     class NetworkDownload;
     class ZipFile;
+    class ZipFileReader;
 } // namespace utils
 
 #include <QtCore/QSharedPointer>
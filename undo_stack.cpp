@@ -1,9 +1,17 @@
 #include "undo_stack.h"
 
 #include <map>
+#include <memory>
+#include <numeric>
 #include <ranges>
+#include <typeinfo>
 
+#include <QtCore/QDebug>
+#include <QtCore/QHash>
 #include <QtCore/QJsonObject>
+#include <QtCore/QMutex>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
 
 #include "app.h"
 #include "preferences.h"
@@ -11,34 +19,114 @@
 #include "reference_image.h"
 #include "widgets/reference_window.h"
 
+#include "utils/image.h"
+
 namespace
 {
-    class ReferenceEntry : public UndoStack::UndoEntry
+    // An object's state from toJson. Once diffed against a newer state it only holds the properties that
+    // differ (a delta), which are applied on top of the object's current state when undoing.
+    class JsonState
     {
         QJsonObject m_json;
+        bool m_isDelta = false;
+
+    public:
+        JsonState() = default;
+        explicit JsonState(QJsonObject json);
+
+        bool isEmpty() const;
+        // Approximate bytes used
+        qint64 size() const;
+        // Removes the properties that are the same in newer. Returns false if none differ.
+        bool diffAgainst(const JsonState &newer);
+        // The state to pass to fromJson given the object's current state
+        QJsonObject applyTo(QJsonObject current) const;
+        // current reduced to the properties in this delta. Used by cloneAtPresent so redo steps stay deltas.
+        JsonState sameProperties(const QJsonObject &current) const;
+    };
+
+    class ReferenceEntry : public UndoStack::UndoEntry
+    {
+        JsonState m_state;
         ReferenceImageSP m_refImage;
 
     public:
         explicit ReferenceEntry(const ReferenceImageSP &refItem);
         bool undo() override;
         UndoStack::UndoEntryUP cloneAtPresent() const override;
+        qint64 size() const override;
+        quintptr target() const override;
+        bool diffAgainst(const UndoEntry &newer) override;
     };
 
     class WindowEntry : public UndoStack::UndoEntry
     {
         RefWindowId m_identifier;
-        QJsonObject m_json;
+        JsonState m_state;
         QPointer<ReferenceWindow> m_refWindow;
 
     public:
         explicit WindowEntry(ReferenceWindow *refWindow);
         bool undo() override;
         UndoStack::UndoEntryUP cloneAtPresent() const override;
+        qint64 size() const override;
+        quintptr target() const override;
+        bool diffAgainst(const UndoEntry &newer) override;
+    };
+
+    // The image data kept by an ImageDataEntry. Either the file data the image was decoded from or the image
+    // itself until CompressSnapshotTask has compressed it.
+    struct ImageSnapshot
+    {
+        QMutex mutex;
+        QImage image;
+        QByteArray compressed;
+        std::shared_ptr<const void> compressedOwner; // See ReferenceImage::compressedImageOwner
+        QByteArray compressedHash;                   // See ReferenceImage::compressedImageHash
+    };
+    using ImageSnapshotSP = std::shared_ptr<ImageSnapshot>;
+
+    // Compresses a snapshot's image in the global thread pool then releases the uncompressed image
+    class CompressSnapshotTask : public QRunnable
+    {
+        ImageSnapshotSP m_snapshot;
+
+    public:
+        explicit CompressSnapshotTask(ImageSnapshotSP snapshot)
+            : m_snapshot(std::move(snapshot))
+        {}
+
+        void run() override
+        {
+            if (m_snapshot.use_count() == 1)
+            {
+                return; // The undo entry was removed before the task ran
+            }
+
+            QImage image;
+            {
+                const QMutexLocker lock(&m_snapshot->mutex);
+                image = m_snapshot->image;
+            }
+            // Lossless and fast. The data is only decoded again if the step is undone.
+            const utils::ImageCodec codec{"png", utils::pngQualityForLevel(1)};
+            const QByteArray compressed = utils::encodeImage(image, codec);
+            if (compressed.isEmpty())
+            {
+                return; // Keep the uncompressed image
+            }
+
+            const QMutexLocker lock(&m_snapshot->mutex);
+            m_snapshot->compressed = compressed;
+            m_snapshot->image = QImage();
+        }
     };
 
     class ImageDataEntry : public UndoStack::UndoEntry
     {
-        QImage m_imageData;
+        ImageSnapshotSP m_snapshot;
+        QSize m_imageSize; // Full resolution size if the snapshot's image is downsampled
+        qreal m_imageScale = 1.0; // The scale the image was decoded at relative to m_imageSize
         ReferenceImageSP m_refImage;
 
     public:
@@ -58,12 +146,70 @@ namespace
         GlobalStateEntry();
         bool undo() override;
         UndoStack::UndoEntryUP cloneAtPresent() const override;
+        qint64 size() const override;
+        quintptr target() const override;
+        bool diffAgainst(const UndoEntry &newer) override;
     };
 
+    JsonState::JsonState(QJsonObject json)
+        : m_json(std::move(json))
+    {}
+
+    bool JsonState::isEmpty() const
+    {
+        return m_json.isEmpty();
+    }
+
+    qint64 JsonState::size() const
+    {
+        // Most properties are numbers, bools or short strings. Serializing to measure exactly would cost more
+        // than capturing the state.
+        const qint64 bytesPerProperty = 64;
+        return m_json.size() * bytesPerProperty;
+    }
+
+    bool JsonState::diffAgainst(const JsonState &newer)
+    {
+        for (auto it = m_json.begin(); it != m_json.end();)
+        {
+            it = newer.m_json.value(it.key()) == it.value() ? m_json.erase(it) : std::next(it);
+        }
+        m_isDelta = true;
+        return !m_json.isEmpty();
+    }
+
+    QJsonObject JsonState::applyTo(QJsonObject current) const
+    {
+        if (!m_isDelta)
+        {
+            return m_json;
+        }
+        for (auto it = m_json.constBegin(); it != m_json.constEnd(); ++it)
+        {
+            current.insert(it.key(), it.value());
+        }
+        return current;
+    }
+
+    JsonState JsonState::sameProperties(const QJsonObject &current) const
+    {
+        if (!m_isDelta)
+        {
+            return JsonState(current);
+        }
+        JsonState state;
+        state.m_isDelta = true;
+        for (auto it = m_json.constBegin(); it != m_json.constEnd(); ++it)
+        {
+            state.m_json.insert(it.key(), current.value(it.key()));
+        }
+        return state;
+    }
+
     ReferenceEntry::ReferenceEntry(const ReferenceImageSP &refItem)
         : m_refImage(refItem)
     {
-        if (refItem) { m_json = refItem->toJson(); }
+        if (refItem) { m_state = JsonState(refItem->toJson()); }
     }
 
     bool ReferenceEntry::undo()
@@ -73,13 +219,33 @@ namespace
             return false;
         }
 
-        m_refImage->fromJson(m_json, nullptr);
+        m_refImage->fromJson(m_state.applyTo(m_refImage->toJson()), nullptr);
         return true;
     }
 
     UndoStack::UndoEntryUP ReferenceEntry::cloneAtPresent() const
     {
-        return std::make_unique<ReferenceEntry>(m_refImage);
+        auto entry = std::make_unique<ReferenceEntry>(m_refImage);
+        if (m_refImage)
+        {
+            entry->m_state = m_state.sameProperties(m_refImage->toJson());
+        }
+        return entry;
+    }
+
+    qint64 ReferenceEntry::size() const
+    {
+        return m_state.size();
+    }
+
+    quintptr ReferenceEntry::target() const
+    {
+        return reinterpret_cast<quintptr>(m_refImage.get());
+    }
+
+    bool ReferenceEntry::diffAgainst(const UndoEntry &newer)
+    {
+        return m_state.diffAgainst(static_cast<const ReferenceEntry &>(newer).m_state);
     }
 
     WindowEntry::WindowEntry(ReferenceWindow *refWindow)
@@ -88,13 +254,13 @@ namespace
     {
         if (m_refWindow)
         {
-            m_json = m_refWindow->toJson();
+            m_state = JsonState(m_refWindow->toJson());
         }
     }
 
     bool WindowEntry::undo()
     {
-        if (m_identifier == 0 || m_json.isEmpty())
+        if (m_identifier == 0 || m_state.isEmpty())
         {
             return false;
         }
@@ -104,7 +270,7 @@ namespace
             refWindow = App::ghostRefInstance()->newReferenceWindow();
             refWindow->setIdentifier(m_identifier);
         }
-        refWindow->fromJson(m_json);
+        refWindow->fromJson(m_state.applyTo(refWindow->toJson()));
         refWindow->setVisible(!refWindow->ghostRefHidden());
 
         return true;
@@ -112,15 +278,54 @@ namespace
 
     UndoStack::UndoEntryUP WindowEntry::cloneAtPresent() const
     {
-        return std::make_unique<WindowEntry>(m_refWindow.get());
+        auto entry = std::make_unique<WindowEntry>(m_refWindow.get());
+        if (m_refWindow)
+        {
+            entry->m_state = m_state.sameProperties(m_refWindow->toJson());
+        }
+        return entry;
+    }
+
+    qint64 WindowEntry::size() const
+    {
+        return m_state.size();
+    }
+
+    quintptr WindowEntry::target() const
+    {
+        return static_cast<quintptr>(m_identifier);
+    }
+
+    bool WindowEntry::diffAgainst(const UndoEntry &newer)
+    {
+        return m_state.diffAgainst(static_cast<const WindowEntry &>(newer).m_state);
     }
 
     ImageDataEntry::ImageDataEntry(const ReferenceImageSP &refImage)
-        : m_refImage(refImage)
+        : m_snapshot(std::make_shared<ImageSnapshot>()),
+          m_refImage(refImage)
     {
-        if (refImage) 
+        if (!refImage)
+        {
+            return;
+        }
+
+        m_imageSize = refImage->baseImageSize();
+        if (refImage->isLoaded())
+        {
+            m_imageScale = refImage->baseImageScale();
+        }
+        if (!refImage->compressedImage().isEmpty())
         {
-            m_imageData = refImage->baseImage(); 
+            // The data the base image was decoded from. Shared with the reference so it's free to keep.
+            m_snapshot->compressed = refImage->compressedImage();
+            m_snapshot->compressedOwner = refImage->compressedImageOwner();
+            m_snapshot->compressedHash = refImage->compressedImageHash();
+        }
+        else if (!refImage->baseImage().isNull())
+        {
+            m_snapshot->image = refImage->baseImage();
+            QThreadPool::globalInstance()->start(new CompressSnapshotTask(m_snapshot));
         }
     }
 
@@ -128,7 +333,30 @@ namespace
     {
         if (!m_refImage) { return false; }
 
-        m_refImage->setBaseImage(m_imageData);
+        QImage image;
+        QByteArray compressed;
+        std::shared_ptr<const void> compressedOwner;
+        QByteArray compressedHash;
+        {
+            const QMutexLocker lock(&m_snapshot->mutex);
+            image = m_snapshot->image;
+            compressed = m_snapshot->compressed;
+            compressedOwner = m_snapshot->compressedOwner;
+            compressedHash = m_snapshot->compressedHash;
+        }
+
+        m_refImage->setCompressedImage(compressed, compressedOwner, compressedHash);
+        if (image.isNull() && !compressed.isEmpty())
+        {
+            // Decoded in the thread pool at the scale it was decoded at before. The current image is shown until
+            // it has loaded. Shares the image if something still uses an image decoded from the same data.
+            m_refImage->setLoader(
+                std::make_unique<RefImageLoader>(compressed, DecodeResolution{m_imageScale}, compressedOwner,
+                                                 compressedHash));
+            return true;
+        }
+
+        m_refImage->setBaseImage(image, m_imageSize);
         return true;
     }
 
@@ -139,7 +367,8 @@ namespace
 
     qint64 ImageDataEntry::size() const
     {
-        return m_imageData.sizeInBytes();
+        const QMutexLocker lock(&m_snapshot->mutex);
+        return m_snapshot->image.isNull() ? m_snapshot->compressed.size() : m_snapshot->image.sizeInBytes();
     }
 
     GlobalStateEntry::GlobalStateEntry()
@@ -185,30 +414,108 @@ namespace
         return std::make_unique<GlobalStateEntry>();
     }
 
+    qint64 GlobalStateEntry::size() const
+    {
+        qint64 bytes = m_windowIds.size() * static_cast<qint64>(sizeof(RefWindowId));
+        for (const auto &[refItem, name] : m_referenceNames)
+        {
+            bytes += static_cast<qint64>(sizeof(refItem)) + name.size() * static_cast<qint64>(sizeof(QChar));
+        }
+        return bytes;
+    }
+
+    quintptr GlobalStateEntry::target() const
+    {
+        return 1; // There is only one global state
+    }
+
+    bool GlobalStateEntry::diffAgainst(const UndoEntry &newer)
+    {
+        const auto &newerState = static_cast<const GlobalStateEntry &>(newer);
+        return m_windowIds != newerState.m_windowIds || m_referenceNames != newerState.m_referenceNames;
+    }
+
 } // namespace
 
 void UndoStack::addUndoStep(UndoStep &&undoStep)
 {
     const int maxSteps = appPrefs()->getInt(Preferences::UndoMaxSteps);
+    const qint64 maxBytes = static_cast<qint64>(appPrefs()->getInt(Preferences::UndoMaxMemoryMB)) * 1024 * 1024;
 
     if (maxSteps <= 0)
     {
-        m_undoStack.clear();
-        m_redoStack.clear();
+        clear();
         return;
     }
 
-    m_undoStack.push_back(std::move(undoStep));
-    m_redoStack.clear();
+    // Remove the redo steps
+    while (m_steps.size() > m_undoCount)
+    {
+        m_steps.popBack();
+    }
 
-    // Check the number of steps
-    if (m_undoStack.size() > maxSteps)
+    if (m_steps.capacity() != maxSteps)
     {
-        const int eraseCount = static_cast<int>(m_undoStack.size() - maxSteps);
-        m_undoStack.erase(m_undoStack.begin(), m_undoStack.begin() + eraseCount);
+        m_steps.setCapacity(maxSteps);
+        m_undoCount = m_steps.size();
+        m_undoBytes = 0;
+        for (qsizetype i = 0; i < m_undoCount; i++)
+        {
+            m_undoBytes += m_steps[i].cachedSize();
+        }
+    }
+    if (m_steps.isFull())
+    {
+        removeOldestStep();
+    }
+
+    // Only the newest step keeps the full state of every object it captured
+    if (m_undoCount > 0)
+    {
+        UndoStep &previous = m_steps.back();
+        const qint64 previousSize = previous.cachedSize();
+        previous.diffAgainst(undoStep);
+        m_undoBytes += previous.updateSize() - previousSize;
+    }
+
+    m_undoBytes += undoStep.updateSize();
+    m_steps.pushBack(std::move(undoStep));
+    m_undoCount++;
+
+    if (maxBytes > 0)
+    {
+        trimToBytes(maxBytes);
     }
 
     App::ghostRefInstance()->setUnsavedChanges();
+    emit stepsChanged();
+}
+
+void UndoStack::removeOldestStep()
+{
+    m_undoBytes -= m_steps.front().cachedSize();
+    m_steps.popFront();
+    m_undoCount--;
+}
+
+void UndoStack::trimToBytes(qint64 maxBytes)
+{
+    if (m_undoBytes <= maxBytes)
+    {
+        return;
+    }
+
+    // Images that were compressed since their steps were pushed use less now
+    m_undoBytes = 0;
+    for (qsizetype i = 0; i < m_undoCount; i++)
+    {
+        m_undoBytes += m_steps[i].updateSize();
+    }
+
+    while (m_undoBytes > maxBytes && m_undoCount > 1)
+    {
+        removeOldestStep();
+    }
 }
 
 UndoStack *UndoStack::get()
@@ -301,43 +608,59 @@ void UndoStack::pushWindowAndRefItem(ReferenceWindow *refWindow, const Reference
 
 bool UndoStack::undo()
 {
-    if (m_undoStack.empty())
+    if (m_undoCount == 0)
     {
         return false;
     }
-    UndoStep &undoStep = m_undoStack.back();
-    UndoStep redoStep = undoStep.cloneAtPresent();
-    undoStep.perform();
-    m_undoStack.pop_back();
-    m_redoStack.push_back(std::move(redoStep));
+    // The step is replaced by the redo step for the state it's undoing
+    UndoStep &step = m_steps[m_undoCount - 1];
+    UndoStep redoStep = step.cloneAtPresent();
+    step.perform();
+    m_undoBytes -= step.cachedSize();
+    step = std::move(redoStep);
+    m_undoCount--;
 
     emit undone();
     emit undoneOrRedone();
+    emit stepsChanged();
     return true;
 }
 
 bool UndoStack::redo()
 {
-    if (m_redoStack.empty())
+    if (m_undoCount == m_steps.size())
     {
         return false;
     }
-    UndoStep &redoStep = m_redoStack.back();
-    UndoStep undoStep = redoStep.cloneAtPresent();
-
-    redoStep.perform();
-    m_redoStack.pop_back();
-    m_undoStack.push_back(std::move(undoStep));
+    UndoStep &step = m_steps[m_undoCount];
+    UndoStep undoStep = step.cloneAtPresent();
+    step.perform();
+    step = std::move(undoStep);
+    m_undoBytes += step.updateSize();
+    m_undoCount++;
 
     emit redone();
     emit undoneOrRedone();
+    emit stepsChanged();
     return true;
 }
 
 void UndoStack::clear()
 {
-    m_redoStack.clear();
-    m_undoStack.clear();
+    m_steps.clear();
+    m_undoCount = 0;
+    m_undoBytes = 0;
+    emit stepsChanged();
+}
+
+qint64 UndoStack::memoryUsage() const
+{
+    qint64 total = 0;
+    for (qsizetype i = 0; i < m_steps.size(); i++)
+    {
+        total += m_steps[i].size();
+    }
+    return total;
 }
 
 void UndoStack::UndoStep::addEntry(UndoEntryUP &&entry)
@@ -363,8 +686,31 @@ void UndoStack::UndoStep::perform()
     }
 }
 
+void UndoStack::UndoStep::diffAgainst(const UndoStep &newer)
+{
+    QHash<std::pair<size_t, quintptr>, const UndoEntry *> newerEntries;
+    for (const auto &entry : newer.m_entries)
+    {
+        if (entry->target() != 0)
+        {
+            newerEntries.insert({typeid(*entry).hash_code(), entry->target()}, entry.get());
+        }
+    }
+
+    std::erase_if(m_entries, [&newerEntries](const UndoEntryUP &entry) {
+        const UndoEntry *newerEntry = newerEntries.value({typeid(*entry).hash_code(), entry->target()});
+        return entry->target() != 0 && newerEntry && !entry->diffAgainst(*newerEntry);
+    });
+}
+
 qint64 UndoStack::UndoStep::size() const
 {
     return std::transform_reduce(m_entries.cbegin(), m_entries.cend(), 0LL, std::plus{},
                                  [](const UndoEntryUP &entry) { return entry->size(); });
 }
+
+qint64 UndoStack::UndoStep::updateSize()
+{
+    m_cachedSize = size();
+    return m_cachedSize;
+}
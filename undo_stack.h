@@ -7,6 +7,8 @@
 
 #include "types.h"
 
+#include "utils/ring_buffer.h"
+
 class UndoStack : public QObject
 {
     Q_OBJECT
@@ -27,25 +29,44 @@ public:
         virtual UndoEntryUP cloneAtPresent() const = 0;
 
         virtual qint64 size() const { return 0; }
+
+        // Identifies the object this entry restores. Entries of the same type with the same target in consecutive
+        // steps are diffed by diffAgainst. 0 if the entry is never diffed.
+        virtual quintptr target() const { return 0; }
+        // Reduces this entry to the state that differs from newer, an entry for the same target captured by the
+        // next step. Returns false if nothing differs so the entry can be removed.
+        virtual bool diffAgainst(const UndoEntry & /*newer*/) { return true; }
     };
 
 protected:
     class UndoStep
     {
         std::vector<UndoEntryUP> m_entries;
+        qint64 m_cachedSize = 0;
 
     public:
         void addEntry(UndoEntryUP &&entry);
         UndoStep cloneAtPresent() const;
         void perform();
         qint64 size() const;
+        // The size when updateSize was last called. Entries can shrink after that (e.g. once their image is
+        // compressed).
+        qint64 cachedSize() const;
+        qint64 updateSize();
+        // Reduces the entries to what differs from newer, the step pushed after this one. Undoing newer
+        // restores the state it captured so this step only needs to restore what changed before that.
+        void diffAgainst(const UndoStep &newer);
     };
 
     void addUndoStep(UndoStep &&undoStep);
 
 private:
-    std::vector<UndoStep> m_undoStack;
-    std::vector<UndoStep> m_redoStack;
+    // Undo steps from oldest to newest followed by redo steps from the next one to redo to the last. Steps
+    // are undone and redone in place so pushing, undoing, redoing and removing the oldest step are O(1).
+    utils::RingBuffer<UndoStep> m_steps;
+    qsizetype m_undoCount = 0;
+    // Sum of the undo steps' cached sizes
+    qint64 m_undoBytes = 0;
 
 public:
     // Same as App::ghostRefInstance()->undoStack()
@@ -78,8 +99,27 @@ public:
     // Delete all undo/redo steps
     void clear();
 
+    qsizetype undoCount() const;
+    qsizetype redoCount() const;
+    // Bytes used by all undo and redo steps
+    qint64 memoryUsage() const;
+
 signals:
     void undone();
     void redone();
     void undoneOrRedone();
-};
\ No newline at end of file
+    // Emitted whenever steps are added, undone, redone or removed
+    void stepsChanged();
+
+private:
+    // Removes the oldest undo step
+    void removeOldestStep();
+    // Removes the oldest undo steps until they use at most maxBytes. The newest step is always kept.
+    void trimToBytes(qint64 maxBytes);
+};
+
+inline qsizetype UndoStack::undoCount() const { return m_undoCount; }
+
+inline qsizetype UndoStack::redoCount() const { return m_steps.size() - m_undoCount; }
+
+inline qint64 UndoStack::UndoStep::cachedSize() const { return m_cachedSize; }
\ No newline at end of file
@@ -1,11 +1,234 @@
 #include "image.h"
 
+#include <array>
 #include <ranges>
 
+#include <QtCore/QBuffer>
 #include <QtCore/QDebug>
 #include <QtGui/QImage>
+#include <QtGui/QImageWriter>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GHOST_REF_SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC allows AVX2 intrinsics in any function
+#define GHOST_REF_TARGET_AVX2
+#else
+#define GHOST_REF_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON)
+#define GHOST_REF_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+using SimdLevel = utils::SimdLevel;
+
+namespace
+{
+    // Saturation kernels. Each colour channel becomes c + (max - c) * factor / 256 where max is the
+    // largest colour channel of the pixel. Every kernel gives the same result as the scalar kernel.
+    using SaturationKernel = void (*)(QRgb *pixels, qsizetype count, int factor);
+
+    void reduceSaturationScalar(QRgb *pixels, qsizetype count, int factor)
+    {
+        for (qsizetype i = 0; i < count; i++)
+        {
+            const QRgb rgb = pixels[i];
+            const int red = qRed(rgb);
+            const int green = qGreen(rgb);
+            const int blue = qBlue(rgb);
+            const int max = std::max(std::max(red, green), blue);
+
+            pixels[i] = qRgba(red + (((max - red) * factor) >> 8),
+                              green + (((max - green) * factor) >> 8),
+                              blue + (((max - blue) * factor) >> 8), qAlpha(rgb));
+        }
+    }
+
+#if defined(GHOST_REF_SIMD_X86)
+    bool cpuHasAvx2()
+    {
+#if defined(_MSC_VER)
+        const int osxsaveBit = 1 << 27;
+        const int avxBit = 1 << 28;
+        const int avx2Bit = 1 << 5;
+        const unsigned long long ymmStateMask = 0x6;
+
+        std::array<int, 4> info{};
+        __cpuid(info.data(), 0);
+        if (info[0] < 7) return false;
+
+        __cpuid(info.data(), 1);
+        if (!(info[2] & osxsaveBit) || !(info[2] & avxBit)) return false;
+        // The OS must save the YMM registers
+        if ((_xgetbv(0) & ymmStateMask) != ymmStateMask) return false;
+
+        __cpuidex(info.data(), 7, 0);
+        return (info[1] & avx2Bit) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    void reduceSaturationSse2(QRgb *pixels, qsizetype count, int factor)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lowByteMask = _mm_set1_epi32(0xFF);
+        const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+        const __m128i factors = _mm_set1_epi16(static_cast<short>(factor));
+
+        qsizetype i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            auto *ptr = reinterpret_cast<__m128i *>(pixels + i);
+            const __m128i px = _mm_loadu_si128(ptr);
+
+            // Max of the colour channels copied to each colour channel. Alpha is 0.
+            __m128i max = _mm_max_epu8(_mm_max_epu8(px, _mm_srli_epi32(px, 8)), _mm_srli_epi32(px, 16));
+            max = _mm_and_si128(max, lowByteMask);
+            max = _mm_or_si128(_mm_or_si128(max, _mm_slli_epi32(max, 8)), _mm_slli_epi32(max, 16));
+
+            const __m128i diff = _mm_sub_epi8(max, _mm_and_si128(px, rgbMask));
+            const __m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(diff, zero), factors), 8);
+            const __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(diff, zero), factors), 8);
+
+            _mm_storeu_si128(ptr, _mm_add_epi8(px, _mm_packus_epi16(low, high)));
+        }
+        reduceSaturationScalar(pixels + i, count - i, factor);
+    }
+
+    GHOST_REF_TARGET_AVX2 void reduceSaturationAvx2(QRgb *pixels, qsizetype count, int factor)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i lowByteMask = _mm256_set1_epi32(0xFF);
+        const __m256i rgbMask = _mm256_set1_epi32(0x00FFFFFF);
+        const __m256i factors = _mm256_set1_epi16(static_cast<short>(factor));
+
+        qsizetype i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            auto *ptr = reinterpret_cast<__m256i *>(pixels + i);
+            const __m256i px = _mm256_loadu_si256(ptr);
+
+            __m256i max = _mm256_max_epu8(_mm256_max_epu8(px, _mm256_srli_epi32(px, 8)), _mm256_srli_epi32(px, 16));
+            max = _mm256_and_si256(max, lowByteMask);
+            max = _mm256_or_si256(_mm256_or_si256(max, _mm256_slli_epi32(max, 8)), _mm256_slli_epi32(max, 16));
+
+            // Unpacking and packing both work within 128 bit lanes so the pixel order is kept
+            const __m256i diff = _mm256_sub_epi8(max, _mm256_and_si256(px, rgbMask));
+            const __m256i low = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(diff, zero), factors), 8);
+            const __m256i high = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(diff, zero), factors), 8);
+
+            _mm256_storeu_si256(ptr, _mm256_add_epi8(px, _mm256_packus_epi16(low, high)));
+        }
+        reduceSaturationSse2(pixels + i, count - i, factor);
+    }
+#endif
+
+#if defined(GHOST_REF_SIMD_NEON)
+    void reduceSaturationNeon(QRgb *pixels, qsizetype count, int factor)
+    {
+        const uint32x4_t lowByteMask = vdupq_n_u32(0xFF);
+        const uint32x4_t rgbMask = vdupq_n_u32(0x00FFFFFF);
+        const uint16x8_t factors = vdupq_n_u16(static_cast<uint16_t>(factor));
+
+        qsizetype i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const uint32x4_t px = vld1q_u32(pixels + i);
+            const uint8x16_t pxBytes = vreinterpretq_u8_u32(px);
+
+            uint8x16_t maxBytes = vmaxq_u8(pxBytes, vreinterpretq_u8_u32(vshrq_n_u32(px, 8)));
+            maxBytes = vmaxq_u8(maxBytes, vreinterpretq_u8_u32(vshrq_n_u32(px, 16)));
+            uint32x4_t max = vandq_u32(vreinterpretq_u32_u8(maxBytes), lowByteMask);
+            max = vorrq_u32(vorrq_u32(max, vshlq_n_u32(max, 8)), vshlq_n_u32(max, 16));
+
+            const uint8x16_t diff = vsubq_u8(vreinterpretq_u8_u32(max), vreinterpretq_u8_u32(vandq_u32(px, rgbMask)));
+            const uint16x8_t low = vmulq_u16(vmovl_u8(vget_low_u8(diff)), factors);
+            const uint16x8_t high = vmulq_u16(vmovl_u8(vget_high_u8(diff)), factors);
+            const uint8x16_t scaled = vcombine_u8(vshrn_n_u16(low, 8), vshrn_n_u16(high, 8));
+
+            vst1q_u32(pixels + i, vreinterpretq_u32_u8(vaddq_u8(pxBytes, scaled)));
+        }
+        reduceSaturationScalar(pixels + i, count - i, factor);
+    }
+#endif
+
+    // Fixed point (1 - saturation) so the kernels can use 16 bit multiplies
+    int saturationFactor(qreal saturation)
+    {
+        return qRound((1.0 - std::clamp(saturation, 0., 1.)) * 256);
+    }
+
+    SaturationKernel saturationKernel(SimdLevel simdLevel)
+    {
+        if (!utils::isSimdLevelSupported(simdLevel))
+        {
+            return reduceSaturationScalar;
+        }
+        switch (simdLevel)
+        {
+#if defined(GHOST_REF_SIMD_X86)
+        case SimdLevel::SSE2:
+            return reduceSaturationSse2;
+        case SimdLevel::AVX2:
+            return reduceSaturationAvx2;
+#endif
+#if defined(GHOST_REF_SIMD_NEON)
+        case SimdLevel::NEON:
+            return reduceSaturationNeon;
+#endif
+        default:
+            return reduceSaturationScalar;
+        }
+    }
+
+} // namespace
+
+bool utils::isSimdLevelSupported(SimdLevel simdLevel)
+{
+    switch (simdLevel)
+    {
+    case SimdLevel::Scalar:
+        return true;
+#if defined(GHOST_REF_SIMD_X86)
+    case SimdLevel::SSE2:
+        return true; // Always available on x86-64
+    case SimdLevel::AVX2:
+    {
+        static const bool hasAvx2 = cpuHasAvx2();
+        return hasAvx2;
+    }
+#endif
+#if defined(GHOST_REF_SIMD_NEON)
+    case SimdLevel::NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+SimdLevel utils::bestSimdLevel()
+{
+    for (const SimdLevel simdLevel : {SimdLevel::AVX2, SimdLevel::NEON, SimdLevel::SSE2})
+    {
+        if (isSimdLevelSupported(simdLevel))
+        {
+            return simdLevel;
+        }
+    }
+    return SimdLevel::Scalar;
+}
 
 void utils::reduceSaturation(QImage &image, qreal saturation)
+{
+    reduceSaturation(image, saturation, bestSimdLevel());
+}
+
+void utils::reduceSaturation(QImage &image, qreal saturation, SimdLevel simdLevel)
 {
     switch (image.format())
     {
@@ -18,25 +241,57 @@ void utils::reduceSaturation(QImage &image, qreal saturation)
         return;
     }
 
-    saturation = std::clamp(saturation, 0., 1.);
-
-    const auto inverseSat = 1.F - static_cast<float>(saturation);
+    const int factor = saturationFactor(saturation);
+    const SaturationKernel kernel = saturationKernel(simdLevel);
 
     for (int y = 0; y < image.height(); y++)
     {
-        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
-        for (int x = 0; x < image.width(); x++)
-        {
-            const QRgb rgb = line[x];
-            const int red = qRed(rgb);
-            const int green = qGreen(rgb);
-            const int blue = qBlue(rgb);
-            const int max = std::max(std::max(red, green), blue);
+        kernel(reinterpret_cast<QRgb *>(image.scanLine(y)), image.width(), factor);
+    }
+}
 
-            line[x] = qRgba(red + static_cast<int>((max - red) * inverseSat),
-                            green + static_cast<int>((max - green) * inverseSat),
-                            blue + static_cast<int>((max - blue) * inverseSat), qAlpha(rgb));
-        }
+void utils::reduceSaturation(QRgb *pixels, qsizetype count, qreal saturation)
+{
+    static const SaturationKernel kernel = saturationKernel(bestSimdLevel());
+    kernel(pixels, count, saturationFactor(saturation));
+}
+
+bool utils::canEncodeImageFormat(const QByteArray &format)
+{
+    static const QList<QByteArray> supported = QImageWriter::supportedImageFormats();
+    return supported.contains(format.toLower());
+}
+
+QByteArray utils::encodeImage(const QImage &image, const ImageCodec &codec)
+{
+    QByteArray encoded;
+    QBuffer buf(&encoded);
+    buf.open(QIODevice::WriteOnly);
+
+    QImageWriter writer(&buf, codec.format);
+    writer.setQuality(codec.quality);
+    if (!writer.write(image))
+    {
+        qCritical() << "Unable to encode image as" << codec.format << writer.errorString();
+        return {};
+    }
+    return encoded;
+}
+
+int utils::pngQualityForLevel(int level)
+{
+    // Qt's PNG writer uses zlib level (100 - quality) * 9 / 91. Round up so it maps back to level.
+    level = std::clamp(level, 0, 9);
+    return 100 - (level * 91 + 8) / 9;
+}
+
+void utils::convertToRenderFormat(QImage &image)
+{
+    const QImage::Format format =
+        image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+    if (!image.isNull() && image.format() != format)
+    {
+        image.convertTo(format);
     }
 }
 
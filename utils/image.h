@@ -1,15 +1,57 @@
 #pragma once
 
+#include <QtCore/QByteArray>
 #include <QtCore/qtypes.h>
+#include <QtGui/qrgb.h>
 
 class QImage;
 
 namespace utils
 {
-    // Reduces the saturation of image to saturation * it's current value.
+    // The format and settings used to encode an image
+    struct ImageCodec
+    {
+        QByteArray format = "png";
+        int quality = -1; // See QImageWriter::setQuality. -1 uses the format's default
+    };
+
+    // Returns true if Qt has an image plugin that can write format
+    bool canEncodeImageFormat(const QByteArray &format);
+
+    // Encodes image using codec. Returns an empty array on failure. Thread safe.
+    QByteArray encodeImage(const QImage &image, const ImageCodec &codec);
+
+    // The PNG writer quality that gives the zlib compression level (0 fastest - 9 smallest)
+    int pngQualityForLevel(int level);
+
+    // Instruction sets that image kernels are vectorized for
+    enum class SimdLevel
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+        NEON
+    };
+
+    // Returns true if simdLevel's kernels were compiled in and can run on this CPU
+    bool isSimdLevelSupported(SimdLevel simdLevel);
+    // The fastest SimdLevel supported by this CPU
+    SimdLevel bestSimdLevel();
+
+    // Reduces the saturation of image to saturation * it's current value. Uses the kernel for the fastest
+    // instruction set this CPU supports.
     void reduceSaturation(QImage &image, qreal saturation);
+    // Same as above using the kernel for simdLevel. Uses the scalar kernel if simdLevel isn't supported.
+    void reduceSaturation(QImage &image, qreal saturation, SimdLevel simdLevel);
+    // Reduces the saturation of count (A)RGB32 pixels
+    void reduceSaturation(QRgb *pixels, qsizetype count, qreal saturation);
 
     // Returns true if image has any pixels that are not opaque
     bool hasTransparentPixels(const QImage &image);
 
+    // Converts image to the format images are rendered in (RGB32, or ARGB32_Premultiplied if it has an alpha
+    // channel). These are the formats QPainter draws fastest and their pixels can be copied and desaturated as
+    // QRgb. Images that are already in that format aren't changed.
+    void convertToRenderFormat(QImage &image);
+
 } // namespace utils
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "image_cache.h"
+
+#include <algorithm>
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QMutexLocker>
+
+#include "image.h"
+
+using ImageCache = utils::ImageCache;
+
+ImageCache &ImageCache::instance()
+{
+    static ImageCache cache;
+    return cache;
+}
+
+QByteArray ImageCache::contentHash(const QByteArray &fileData)
+{
+    return QCryptographicHash::hash(fileData, QCryptographicHash::Sha1);
+}
+
+ImageCache::EntrySP ImageCache::decode(const QByteArray &fileData,
+                                       const std::shared_ptr<const void> &fileDataOwner,
+                                       const QByteArray &hash)
+{
+    const QByteArray key = hash.isEmpty() ? contentHash(fileData) : hash;
+    if (EntrySP entry = find(key))
+    {
+        return entry;
+    }
+
+    // Decode without holding the lock so other images can be loaded at the same time
+    QImage image;
+    if (!image.loadFromData(fileData))
+    {
+        return nullptr;
+    }
+    utils::convertToRenderFormat(image); // So ImagePyramid doesn't keep a converted copy
+    return insert(key, fileData, image, fileDataOwner);
+}
+
+ImageCache::EntrySP ImageCache::find(const QByteArray &hash)
+{
+    const QMutexLocker lock(&m_mutex);
+    const auto it = m_entries.constFind(hash);
+    if (it == m_entries.cend())
+    {
+        return nullptr;
+    }
+    if (EntrySP entry = it->lock())
+    {
+        return entry;
+    }
+    m_entries.erase(it);
+    return nullptr;
+}
+
+ImageCache::EntrySP ImageCache::insert(const QByteArray &hash,
+                                       const QByteArray &fileData,
+                                       const QImage &image,
+                                       const std::shared_ptr<const void> &fileDataOwner)
+{
+    const QMutexLocker lock(&m_mutex);
+    if (EntrySP existing = m_entries.value(hash).lock())
+    {
+        return existing;
+    }
+
+    // The images of expired entries have already been freed. Only their keys are left to remove. They're
+    // removed when the cache has doubled in size since the last sweep so each insert only pays for a few.
+    if (m_entries.size() >= m_sweepSize)
+    {
+        for (auto it = m_entries.begin(); it != m_entries.end();)
+        {
+            it = it->expired() ? m_entries.erase(it) : std::next(it);
+        }
+        m_sweepSize = std::max<qsizetype>(64, m_entries.size() * 2);
+    }
+
+    EntrySP entry = std::make_shared<const Entry>(fileData, image, fileDataOwner, hash);
+    m_entries.insert(hash, entry);
+    return entry;
+}
+
+qsizetype ImageCache::size()
+{
+    const QMutexLocker lock(&m_mutex);
+    return std::count_if(m_entries.cbegin(), m_entries.cend(), [](const auto &entry) { return !entry.expired(); });
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <memory>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtGui/QImage>
+
+namespace utils
+{
+    /*
+    Cache of decoded images keyed by a hash of the file data they were decoded from. Decoding the same file
+    data again returns the entry that is already loaded so the QImage and QByteArray are shared instead of
+    copied. Entries are reference counted by their shared pointers and the cache only holds weak pointers,
+    so an entry's image is freed as soon as nothing that loaded it is using it. Thread safe.
+    */
+    class ImageCache
+    {
+    public:
+        struct Entry
+        {
+            QByteArray fileData;
+            QImage image;
+            // Keeps fileData valid if it refers to memory it doesn't own (e.g. a memory mapped session file)
+            std::shared_ptr<const void> fileDataOwner;
+            QByteArray hash; // The key the entry is cached with
+        };
+        using EntrySP = std::shared_ptr<const Entry>;
+
+    private:
+        QMutex m_mutex;
+        QHash<QByteArray, std::weak_ptr<const Entry>> m_entries;
+        // Expired entries are removed once the cache has grown to this size so inserting stays constant time
+        qsizetype m_sweepSize = 64;
+
+    public:
+        ImageCache() = default;
+        ImageCache(const ImageCache &) = delete;
+        ImageCache &operator=(const ImageCache &) = delete;
+
+        // The cache shared by the whole application
+        static ImageCache &instance();
+
+        // The key that fileData is cached with
+        static QByteArray contentHash(const QByteArray &fileData);
+
+        // Returns the entry for fileData, decoding it if it isn't cached. Null if fileData can't be decoded.
+        // fileDataOwner is kept by a new entry (see Entry::fileDataOwner). hash is fileData's contentHash if
+        // it's already known. Otherwise it's calculated.
+        EntrySP decode(const QByteArray &fileData,
+                       const std::shared_ptr<const void> &fileDataOwner = {},
+                       const QByteArray &hash = {});
+
+        // Returns the entry with the hash key. Null if it isn't cached or no longer in use.
+        EntrySP find(const QByteArray &hash);
+        // Caches image as decoded from fileData. If the same file data was cached in the meantime then the
+        // existing entry is returned instead.
+        EntrySP insert(const QByteArray &hash,
+                       const QByteArray &fileData,
+                       const QImage &image,
+                       const std::shared_ptr<const void> &fileDataOwner = {});
+
+        // The number of entries that are in use
+        qsizetype size();
+    };
+} // namespace utils
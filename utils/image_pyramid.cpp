@@ -0,0 +1,250 @@
+#include "image_pyramid.h"
+
+#include <algorithm>
+
+#include <QtCore/QtMath>
+#include <QtGui/QPainter>
+
+#include "image.h"
+
+using ImagePyramid = utils::ImagePyramid;
+
+ImagePyramid::ImagePyramid(const QImage &image)
+{
+    setImage(image);
+}
+
+bool ImagePyramid::setImage(const QImage &image)
+{
+    if (image.cacheKey() == m_sourceKey)
+    {
+        return false;
+    }
+    m_sourceKey = image.cacheKey();
+    // Shares image if it's already in the render format. Decoded images are converted when they're loaded so
+    // they aren't kept twice.
+    m_image = image;
+    utils::convertToRenderFormat(m_image);
+    clear();
+    return true;
+}
+
+void ImagePyramid::clear()
+{
+    m_levels.clear();
+    m_tiles.clear();
+    m_tileScale = 0.0;
+}
+
+qint64 ImagePyramid::cacheBytes() const
+{
+    qint64 total = m_image.cacheKey() == m_sourceKey ? 0 : m_image.sizeInBytes();
+    for (const auto &level : m_levels)
+    {
+        total += level.sizeInBytes();
+    }
+    for (const auto &tile : m_tiles)
+    {
+        total += tile.sizeInBytes();
+    }
+    return total;
+}
+
+QSize ImagePyramid::scaledSize(qreal scale) const
+{
+    const QSizeF size = m_image.size().toSizeF() * scale;
+    return {qCeil(size.width()), qCeil(size.height())};
+}
+
+QRect ImagePyramid::tileAlignedRect(const QRect &rect, qreal scale) const
+{
+    const QRect scaledRect({0, 0}, scaledSize(scale));
+    const QRect clamped = rect.intersected(scaledRect);
+    if (clamped.isEmpty())
+    {
+        return {};
+    }
+    const QPoint topLeft(clamped.left() / tileSize * tileSize, clamped.top() / tileSize * tileSize);
+    const QPoint bottomRight((clamped.right() / tileSize + 1) * tileSize - 1,
+                             (clamped.bottom() / tileSize + 1) * tileSize - 1);
+    return QRect(topLeft, bottomRight).intersected(scaledRect);
+}
+
+QImage ImagePyramid::render(const QRect &region, qreal scale, const ImageEffects &effects)
+{
+    QImage target;
+    render(region, scale, target, effects);
+    return target;
+}
+
+bool ImagePyramid::render(const QRect &region, qreal scale, QImage &target, const ImageEffects &effects)
+{
+    const QRect scaledRect({0, 0}, scaledSize(scale));
+    const QRect targetRect = region.intersected(scaledRect);
+    if (m_image.isNull() || targetRect.isEmpty())
+    {
+        target = QImage();
+        return true;
+    }
+
+    const QImage &level = levelForScale(scale);
+    const bool resample = level.size() != scaledRect.size();
+    if (!resample && targetRect == level.rect() && effects.isNull())
+    {
+        target = level; // Nothing to change so share the level's pixels
+        return true;
+    }
+
+    const QRect tiles = resample ? updateTiles(level, targetRect, scale) : QRect();
+    if (resample && tiles.isNull())
+    {
+        return false;
+    }
+
+    if (target.size() != targetRect.size() || target.format() != m_image.format() || !target.isDetached())
+    {
+        target = QImage(targetRect.size(), m_image.format());
+    }
+
+    const int width = targetRect.width();
+    const int height = targetRect.height();
+    const qsizetype bytesPerLine = target.bytesPerLine();
+    uchar *bits = target.bits();
+    for (int y = 0; y < height; y++)
+    {
+        auto *dest = reinterpret_cast<QRgb *>(bits + (y * bytesPerLine));
+        const int srcY = targetRect.top() + (effects.flipVertical ? height - 1 - y : y);
+
+        copyRow(level, resample, srcY, targetRect.left(), width, dest, effects.flipHorizontal);
+        if (effects.saturation < 1.0)
+        {
+            // Desaturate while the row is still in the cache
+            utils::reduceSaturation(dest, width, effects.saturation);
+        }
+    }
+
+    if (resample)
+    {
+        // Drop tiles that aren't next to the rendered region so the cache doesn't grow to the whole image
+        const QRect keptTiles = tiles.adjusted(-1, -1, 1, 1);
+        for (auto it = m_tiles.begin(); it != m_tiles.end();)
+        {
+            it = keptTiles.contains(it.key()) ? std::next(it) : m_tiles.erase(it);
+        }
+    }
+    return true;
+}
+
+void ImagePyramid::setCancelCheck(std::function<bool()> isCancelled)
+{
+    m_isCancelled = std::move(isCancelled);
+}
+
+const QImage &ImagePyramid::levelForScale(qreal scale)
+{
+    const QSize targetSize = scaledSize(scale);
+    const QImage *level = &m_image;
+
+    for (qsizetype i = 0;; ++i)
+    {
+        const QSize halfSize((level->width() + 1) / 2, (level->height() + 1) / 2);
+        if (halfSize.width() < targetSize.width() || halfSize.height() < targetSize.height()
+            || halfSize == level->size())
+        {
+            return *level;
+        }
+        if (i == m_levels.size())
+        {
+            const QImage halved = level->scaled(halfSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            m_levels.push_back(halved.convertToFormat(m_image.format()));
+        }
+        level = &m_levels[i];
+    }
+}
+
+QImage ImagePyramid::renderTile(const QImage &level, QPoint tile, qreal scale) const
+{
+    const QRect scaledRect({0, 0}, scaledSize(scale));
+    const QRect tileRect = QRect(tile * tileSize, QSize(tileSize, tileSize)).intersected(scaledRect);
+
+    QImage tileImage(tileRect.size(), m_image.format());
+    tileImage.fill(Qt::transparent);
+
+    // Draw the whole level so pixels at the tile's edges are filtered with their neighbours from the
+    // adjacent tiles. The raster engine only samples the part of the level that covers the tile.
+    QPainter painter(&tileImage);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.translate(-tileRect.topLeft());
+    painter.scale(scaledRect.width() / static_cast<qreal>(level.width()),
+                  scaledRect.height() / static_cast<qreal>(level.height()));
+    painter.drawImage(0, 0, level);
+
+    return tileImage;
+}
+
+QRect ImagePyramid::updateTiles(const QImage &level, const QRect &region, qreal scale)
+{
+    if (!qFuzzyCompare(scale, m_tileScale))
+    {
+        m_tiles.clear();
+        m_tileScale = scale;
+    }
+
+    const QRect tiles(QPoint(region.left() / tileSize, region.top() / tileSize),
+                      QPoint(region.right() / tileSize, region.bottom() / tileSize));
+
+    for (int row = tiles.top(); row <= tiles.bottom(); ++row)
+    {
+        for (int col = tiles.left(); col <= tiles.right(); ++col)
+        {
+            const QPoint tile(col, row);
+            if (m_tiles.contains(tile))
+            {
+                continue;
+            }
+            if (m_isCancelled && m_isCancelled())
+            {
+                return {};
+            }
+            m_tiles.insert(tile, renderTile(level, tile, scale));
+        }
+    }
+    return tiles;
+}
+
+void ImagePyramid::copyRow(const QImage &level, bool resample, int y, int x, int width, QRgb *dest, bool flip) const
+{
+    // Copies count pixels from src to the row starting at destX, mirroring them if the row is flipped
+    const auto copyPixels = [dest, width, flip](const QRgb *src, int destX, int count)
+    {
+        if (flip)
+        {
+            std::reverse_copy(src, src + count, dest + (width - destX - count));
+        }
+        else
+        {
+            std::copy_n(src, count, dest + destX);
+        }
+    };
+
+    if (!resample)
+    {
+        copyPixels(reinterpret_cast<const QRgb *>(level.constScanLine(y)) + x, 0, width);
+        return;
+    }
+
+    const int row = y / tileSize;
+    const int tileY = y - (row * tileSize);
+    const int right = x + width;
+    for (int col = x / tileSize; col * tileSize < right; ++col)
+    {
+        const QImage tileImage = m_tiles.value(QPoint(col, row));
+        const int tileLeft = col * tileSize;
+        const int start = std::max(x, tileLeft);
+        const int end = std::min(right, tileLeft + tileImage.width());
+
+        const auto *src = reinterpret_cast<const QRgb *>(tileImage.constScanLine(tileY));
+        copyPixels(src + (start - tileLeft), start - x, end - start);
+    }
+}
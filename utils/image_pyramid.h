@@ -0,0 +1,92 @@
+#pragma once
+
+#include <functional>
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QPoint>
+#include <QtCore/QRect>
+#include <QtGui/QImage>
+
+namespace utils
+{
+    // Changes applied to the regions rendered by an ImagePyramid in the same pass that copies the tiles
+    struct ImageEffects
+    {
+        bool flipHorizontal = false;
+        bool flipVertical = false;
+        qreal saturation = 1.0;
+
+        bool isNull() const;
+    };
+
+    /*
+    Renders regions of an image at any scale without resampling the whole image. Keeps successively
+    halved copies of the image (built as they are needed) so a region is only ever resampled from a level
+    at most twice its target size. Rendered regions are split into tiles of tileSize * tileSize px which
+    are cached for the most recent scale, so moving the region only renders the newly exposed tiles.
+    Not thread safe.
+    */
+    class ImagePyramid
+    {
+        qint64 m_sourceKey = 0; // cacheKey of the image passed to setImage
+        QImage m_image;
+        QList<QImage> m_levels; // m_levels[i] is m_image halved i + 1 times
+
+        qreal m_tileScale = 0.0;
+        QHash<QPoint, QImage> m_tiles;
+
+        std::function<bool()> m_isCancelled;
+
+    public:
+        static constexpr int tileSize = 512;
+
+        ImagePyramid() = default;
+        explicit ImagePyramid(const QImage &image);
+
+        // The full size image. Converted to RGB32 or ARGB32_Premultiplied if it was set with any other format.
+        const QImage &image() const;
+        // Sets the full size image. Clears the cached levels and tiles if image is not the current image.
+        // Returns true if the image changed.
+        bool setImage(const QImage &image);
+        void clear();
+        // Bytes used by the cached levels and tiles, and by image() if it's a converted copy of the image passed
+        // to setImage
+        qint64 cacheBytes() const;
+
+        // The size of the image scaled by scale (rounded up)
+        QSize scaledSize(qreal scale) const;
+        // Returns the tile aligned rect containing rect. Clamped to the image scaled by scale.
+        QRect tileAlignedRect(const QRect &rect, qreal scale) const;
+
+        // Renders region of the image scaled by scale then applies effects. region is in scaled image
+        // coordinates. The result has the image's format (see image()).
+        QImage render(const QRect &region, qreal scale, const ImageEffects &effects = {});
+        // Same as above but renders into target. target's pixels are reused if it already has the right size
+        // and format and isn't shared with another QImage. Each pixel is written once, copying it from the
+        // cached tiles, flipping and desaturating it in a single pass. Returns false if cancelled.
+        bool render(const QRect &region, qreal scale, QImage &target, const ImageEffects &effects = {});
+
+        // Sets a function that is checked between rendering tiles. If it returns true then render stops and
+        // returns false. Tiles that were rendered before stopping are kept.
+        void setCancelCheck(std::function<bool()> isCancelled);
+
+    private:
+        // Returns the smallest level that is at least as large as the image scaled by scale
+        const QImage &levelForScale(qreal scale);
+        QImage renderTile(const QImage &level, QPoint tile, qreal scale) const;
+        // Renders the tiles covering region that aren't cached. Returns the tiles' indices or a null rect if
+        // cancelled.
+        QRect updateTiles(const QImage &level, const QRect &region, qreal scale);
+        // Copies width pixels of row y starting at x from level (or the tiles if level needs resampling)
+        void copyRow(const QImage &level, bool resample, int y, int x, int width, QRgb *dest, bool flip) const;
+    };
+
+    inline bool ImageEffects::isNull() const
+    {
+        return !flipHorizontal && !flipVertical && saturation >= 1.0;
+    }
+
+    inline const QImage &ImagePyramid::image() const { return m_image; }
+
+} // namespace utils
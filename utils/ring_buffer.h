@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <QtCore/qtypes.h>
+
+namespace utils
+{
+    /*
+    Fixed capacity double ended queue stored in a single allocation. Elements are indexed from the oldest
+    (front) to the newest (back). Pushing to a full buffer removes the front element so pushing, popping and
+    removing from either end never move the other elements. T must be default constructible and movable.
+    */
+    template <typename T>
+    class RingBuffer
+    {
+        std::vector<T> m_slots;
+        qsizetype m_head = 0; // Slot of the front element
+        qsizetype m_size = 0;
+
+    public:
+        explicit RingBuffer(qsizetype capacity = 0);
+
+        qsizetype capacity() const { return std::ssize(m_slots); }
+        qsizetype size() const { return m_size; }
+        bool isEmpty() const { return m_size == 0; }
+        bool isFull() const { return m_size == capacity(); }
+
+        // Changes the capacity keeping the newest elements that fit. O(size).
+        void setCapacity(qsizetype capacity);
+
+        // index 0 is the front (oldest) element
+        T &operator[](qsizetype index) { return m_slots[slot(index)]; }
+        const T &operator[](qsizetype index) const { return m_slots[slot(index)]; }
+        T &front() { return (*this)[0]; }
+        T &back() { return (*this)[m_size - 1]; }
+
+        // Adds value after the back element. If the buffer is full then the front element is removed first.
+        // Does nothing if the capacity is 0.
+        void pushBack(T &&value);
+        void popFront();
+        void popBack();
+        void clear();
+
+    private:
+        qsizetype slot(qsizetype index) const { return (m_head + index) % capacity(); }
+    };
+
+    template <typename T>
+    RingBuffer<T>::RingBuffer(qsizetype capacity)
+        : m_slots(capacity)
+    {}
+
+    template <typename T>
+    void RingBuffer<T>::setCapacity(qsizetype capacity)
+    {
+        if (capacity == this->capacity())
+        {
+            return;
+        }
+
+        std::vector<T> slots(capacity);
+        const qsizetype keep = std::min(m_size, capacity);
+        for (qsizetype i = 0; i < keep; i++)
+        {
+            slots[i] = std::move((*this)[m_size - keep + i]);
+        }
+        m_slots = std::move(slots);
+        m_head = 0;
+        m_size = keep;
+    }
+
+    template <typename T>
+    void RingBuffer<T>::pushBack(T &&value)
+    {
+        if (capacity() == 0)
+        {
+            return;
+        }
+        if (isFull())
+        {
+            popFront();
+        }
+        m_slots[slot(m_size)] = std::move(value);
+        m_size++;
+    }
+
+    template <typename T>
+    void RingBuffer<T>::popFront()
+    {
+        if (m_size > 0)
+        {
+            front() = T(); // Release the element now rather than when the slot is reused
+            m_head = (m_head + 1) % capacity();
+            m_size--;
+        }
+    }
+
+    template <typename T>
+    void RingBuffer<T>::popBack()
+    {
+        if (m_size > 0)
+        {
+            back() = T();
+            m_size--;
+        }
+    }
+
+    template <typename T>
+    void RingBuffer<T>::clear()
+    {
+        while (!isEmpty())
+        {
+            popBack();
+        }
+        m_head = 0;
+    }
+} // namespace utils
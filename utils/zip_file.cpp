@@ -2,19 +2,25 @@
 
 #include <algorithm>
 
+#include <QtCore/QBuffer>
 #include <QtCore/QDebug>
 #include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
 #include <QtCore/QList>
+#include <QtCore/QSet>
 #include <QtCore/Qt>
+#include <QtCore/QtEndian>
 
 #include <mz.h>
 #include <mz_os.h>
 #include <mz_strm.h>
-#include <mz_strm_mem.h>
 #include <mz_zip.h>
 #include <mz_zip_rw.h>
 
 using ZipFile = utils::ZipFile;
+using ZipFileReader = utils::ZipFileReader;
+using ZipFileWriter = utils::ZipFileWriter;
 using FileEntry = ZipFile::FileEntry;
 
 namespace
@@ -56,11 +62,104 @@ namespace
         }
     };
 
-    using MemStream = CreateDelete<void *, mz_stream_mem_create, mz_stream_mem_delete>;
     using ZipHandle = CreateDelete<void *, mz_zip_create, mz_zip_delete>;
     using ZipReader = CreateDelete<void *, mz_zip_reader_create, mz_zip_reader_delete>;
     using ZipWriter = CreateDelete<void *, mz_zip_writer_create, mz_zip_writer_delete>;
 
+    // A minizip stream that reads from and writes to a QIODevice. The device must already be open.
+    struct DeviceStream
+    {
+        mz_stream stream; // Must be the first member
+        QIODevice *device;
+        // If not negative then only the first size bytes of the device are read, as if it ends there
+        qint64 size;
+    };
+
+    QIODevice *streamDevice(void *stream)
+    {
+        return static_cast<DeviceStream *>(stream)->device;
+    }
+
+    qint64 streamSize(void *stream)
+    {
+        const auto *deviceStream = static_cast<DeviceStream *>(stream);
+        return deviceStream->size >= 0 ? deviceStream->size : deviceStream->device->size();
+    }
+
+    int32_t deviceStreamOpen([[maybe_unused]] void *stream, [[maybe_unused]] const char *path,
+                             [[maybe_unused]] int32_t mode)
+    {
+        return MZ_OK;
+    }
+
+    int32_t deviceStreamIsOpen(void *stream)
+    {
+        return streamDevice(stream)->isOpen() ? MZ_OK : MZ_OPEN_ERROR;
+    }
+
+    int32_t deviceStreamRead(void *stream, void *buf, int32_t size)
+    {
+        QIODevice *device = streamDevice(stream);
+        const qint64 maxSize = std::clamp<qint64>(streamSize(stream) - device->pos(), 0, size);
+        const qint64 bytesRead = device->read(static_cast<char *>(buf), maxSize);
+        return (bytesRead < 0) ? MZ_READ_ERROR : static_cast<int32_t>(bytesRead);
+    }
+
+    int32_t deviceStreamWrite(void *stream, const void *buf, int32_t size)
+    {
+        const qint64 bytesWritten = streamDevice(stream)->write(static_cast<const char *>(buf), size);
+        return (bytesWritten != size) ? MZ_WRITE_ERROR : size;
+    }
+
+    int64_t deviceStreamTell(void *stream)
+    {
+        return streamDevice(stream)->pos();
+    }
+
+    int32_t deviceStreamSeek(void *stream, int64_t offset, int32_t origin)
+    {
+        QIODevice *device = streamDevice(stream);
+        qint64 newPos = offset;
+
+        switch (origin)
+        {
+        case MZ_SEEK_SET:
+            break;
+        case MZ_SEEK_CUR:
+            newPos += device->pos();
+            break;
+        case MZ_SEEK_END:
+            newPos += streamSize(stream);
+            break;
+        default:
+            return MZ_SEEK_ERROR;
+        }
+        return device->seek(newPos) ? MZ_OK : MZ_SEEK_ERROR;
+    }
+
+    int32_t deviceStreamClose([[maybe_unused]] void *stream)
+    {
+        return MZ_OK;
+    }
+
+    int32_t deviceStreamError([[maybe_unused]] void *stream)
+    {
+        return MZ_OK;
+    }
+
+    mz_stream_vtbl deviceStreamVtbl = {deviceStreamOpen, deviceStreamIsOpen, deviceStreamRead, deviceStreamWrite,
+                                       deviceStreamTell, deviceStreamSeek,   deviceStreamClose, deviceStreamError,
+                                       nullptr,          nullptr,            nullptr,           nullptr};
+
+    DeviceStream createDeviceStream(QIODevice *device)
+    {
+        DeviceStream deviceStream = {};
+        deviceStream.stream.vtbl = &deviceStreamVtbl;
+        deviceStream.device = device;
+        deviceStream.size = -1;
+        return deviceStream;
+    }
+
     QByteArray readEntryData(const ZipReader &zipReader) noexcept
     {
         int32_t err = MZ_OK;
@@ -88,15 +187,9 @@ namespace
         return entryData;
     }
 
-    void writeEntry(const ZipWriter &zipWriter, ZipFile::FileEntry &fileEntry) noexcept
+    bool writeEntry(const ZipWriter &zipWriter, const QString &entryName, const QByteArray &data) noexcept
     {
-        if (fileEntry.data.size() > INT32_MAX)
-        {
-            qCritical() << "Unable to add entry" << fileEntry.filename << "to zip. Entry too large";
-            return;
-        }
-
-        const QByteArray filename = fileEntry.filename.toUtf8();
+        const QByteArray filename = entryName.toUtf8();
         const std::time_t timeNow = std::time(nullptr);
 
         mz_zip_file fileInfo = {0};
@@ -106,74 +199,85 @@ namespace
         fileInfo.creation_date = timeNow;
         fileInfo.modified_date = timeNow;
         fileInfo.version_madeby = MZ_HOST_SYSTEM(MZ_VERSION_MADEBY);
+        fileInfo.uncompressed_size = data.size();
+        // Zip64 extra fields are only added to entries with sizes or offsets that don't fit in 32 bits
+        fileInfo.zip64 = MZ_ZIP64_AUTO;
 
-        auto *buf = static_cast<void *>(fileEntry.data.data());
-        const auto bufSize = static_cast<int32_t>(fileEntry.data.size());
+        int32_t err = MZ_OK;
+        if (err = mz_zip_writer_entry_open(zipWriter.get(), &fileInfo); err != MZ_OK)
+        {
+            qCritical() << "Error opening zip entry for" << entryName << "Error code:" << err;
+            return false;
+        }
 
-        if (const int32_t err = mz_zip_writer_add_buffer(zipWriter.get(), buf, bufSize, &fileInfo); err != MZ_OK)
+        // Written in chunks as minizip only takes 32 bit lengths
+        const qsizetype chunkSize = 1 << 20;
+        for (qsizetype pos = 0; pos < data.size(); pos += chunkSize)
         {
-            qCritical() << "Error adding zip entry for" << fileEntry.filename << "Error code:" << err;
+            const auto len = static_cast<int32_t>(std::min(chunkSize, data.size() - pos));
+            if (err = mz_zip_writer_entry_write(zipWriter.get(), data.constData() + pos, len); err != len)
+            {
+                qCritical() << "Error writing zip entry for" << entryName << "Error code:" << err;
+                mz_zip_writer_entry_close(zipWriter.get());
+                return false;
+            }
+        }
+
+        if (err = mz_zip_writer_entry_close(zipWriter.get()); err != MZ_OK)
+        {
+            qCritical() << "Error closing zip entry for" << entryName << "Error code:" << err;
+            return false;
         }
+        return true;
     }
 
-    // Returns a QList of pointers to FileEntries such that the total size of all entries
-    // is less than around 2GB
-    QList<FileEntry *> prunedEntries(QList<FileEntry> &entries)
+    // Returns true if QDir::cleanPath would change path. Entry names are almost always clean already, so this
+    // avoids allocating a cleaned copy of every name that's looked up.
+    bool needsCleaning(const QString &path)
     {
-        // TODO Move to checking to ZipFile::addFile
-        const qsizetype maxSize = INT32_MAX - (1U << 20U); // Leave space for zip metadata
-        qsizetype totalSize = 0;
-        QList<FileEntry *> pruned;
-
-        for (auto &entry : entries)
+        if (path.endsWith('/') && path.size() > 1)
         {
-            pruned.push_back(&entry);
-            totalSize += entry.data.size();
+            return true;
         }
 
-        if (totalSize > maxSize)
+        qsizetype segmentStart = 0;
+        for (qsizetype i = 0; i <= path.size(); i++)
         {
-            qWarning() << "Session File is too large. Some images will be discarded.";
-
-            // Sort pruned from smallest entry to largest
-            std::sort(pruned.begin(), pruned.end(), [](FileEntry *a, FileEntry *b)
-                      { return a->data.size() < b->data.size(); });
-            while (totalSize > maxSize)
+            if (i < path.size() && path[i] == '\\')
+            {
+                return true;
+            }
+            if (i == path.size() || path[i] == '/')
             {
-                FileEntry *largest = pruned.takeLast();
-                if (!largest)
+                const QStringView segment = QStringView(path).sliced(segmentStart, i - segmentStart);
+                // Empty segments are repeated separators (apart from the root of an absolute path)
+                if ((segment.isEmpty() && i > 0) || segment == u"." || segment == u"..")
                 {
-                    break;
+                    return true;
                 }
-                totalSize -= largest->data.size();
+                segmentStart = i + 1;
             }
         }
-
-        return pruned;
+        return false;
     }
 
     QString cleanPath(const QString &path)
     {
-        return QDir::cleanPath(path);
+        return needsCleaning(path) ? QDir::cleanPath(path) : path;
     }
 
 } // namespace
 
 ZipFile ZipFile::fromBuffer(QByteArray &buffer)
 {
-    if (buffer.count() > INT32_MAX)
-    {
-        qCritical() << "Memory buffer too large to open as a ZipFile";
-        return {};
-    }
+    QBuffer device(&buffer);
+    device.open(QIODevice::ReadOnly);
+    DeviceStream stream = createDeviceStream(&device);
 
     const ZipReader zipReader;
     int32_t err = MZ_OK;
 
-    auto *data = reinterpret_cast<uint8_t *>(buffer.data());
-    auto dataLen = static_cast<int32_t>(buffer.count());
-
-    if (err = mz_zip_reader_open_buffer(zipReader.get(), data, dataLen, 0); err != MZ_OK)
+    if (err = mz_zip_reader_open(zipReader.get(), &stream); err != MZ_OK)
     {
         qCritical() << "minizip: Error opening buffer for reading " << err;
         return {};
@@ -205,94 +309,461 @@ ZipFile ZipFile::fromBuffer(QByteArray &buffer)
 
 QByteArray ZipFile::toBuffer()
 {
-    int32_t err = MZ_OK;
+    QByteArray out;
+    QBuffer buffer(&out);
+    buffer.open(QIODevice::WriteOnly);
 
-    const MemStream memStream;
-    const int32_t growSize = 128 * 1024;
-    mz_stream_mem_set_grow_size(memStream.get(), growSize);
+    ZipFileWriter zipWriter;
+    if (!zipWriter.open(&buffer))
+    {
+        return {};
+    }
+
+    for (const auto &entry : m_fileEntries)
+    {
+        zipWriter.addFile(entry.filename, entry.data);
+    }
 
+    if (!zipWriter.close())
     {
-        const ZipWriter zipWriter;
-        mz_zip_writer_set_compress_method(zipWriter.get(), compressMethod);
-        mz_zip_writer_set_compress_level(zipWriter.get(), compressLevel);
+        return {};
+    }
+    return out;
+}
+
+void ZipFile::addFile(const QString &filename, const QByteArray &data)
+{
+    addFile(filename, std::move(QByteArray(data)));
+}
 
-        if (err = mz_stream_mem_open(memStream.get(), nullptr, MZ_OPEN_MODE_CREATE); err != MZ_OK)
+void ZipFile::addFile(const QString &filename, QByteArray &&data)
+{
+    const QString cleanName = cleanPath(filename);
+
+    if (const auto found = m_indices.constFind(cleanName); found != m_indices.cend())
+    {
+        m_fileEntries[found.value()].data = std::move(data);
+        return;
+    }
+    m_indices.insert(cleanName, m_fileEntries.size());
+    m_fileEntries.push_back({cleanName, std::move(data)});
+}
+
+const QByteArray &utils::ZipFile::getFile(const QString &filename) const
+{
+    static const QByteArray nullArray; // Returned if the file can't be found
+
+    const auto found = m_indices.constFind(cleanPath(filename));
+    return found != m_indices.cend() ? m_fileEntries.at(found.value()).data : nullArray;
+}
+
+bool ZipFile::hasFile(const QString &filename) const
+{
+    return m_indices.contains(cleanPath(filename));
+}
+
+struct utils::ZipFileReaderPrivate
+{
+    struct EntryInfo
+    {
+        QByteArray rawFilename; // Filename as stored in the zip file
+        qint64 headerOffset = 0;
+        qint64 compressedSize = 0;
+        qint64 uncompressedSize = 0;
+        uint16_t compressionMethod = MZ_COMPRESS_METHOD_STORE;
+    };
+
+    QFile file;
+    uchar *mapped = nullptr; // Null if the file could not be memory mapped
+    DeviceStream stream = {};
+    ZipReader zipReader;
+
+    QList<QString> filenames;
+    QHash<QString, EntryInfo> entries;
+
+    // Returns the offset in the file of an entry's data (after its local header) or -1 on error.
+    qint64 dataOffset(const EntryInfo &entry);
+
+    // Returns size bytes of the file from pos. Empty if they're not all in the file.
+    QByteArray read(qint64 pos, qint64 size);
+    // Returns the end of the last complete archive in the file (the end of its last valid end of central
+    // directory record) or -1 if there isn't one. Used to read files with an interrupted append at their end.
+    qint64 findLastArchiveEnd();
+    // Returns the end of the archive whose end of central directory record is at pos or -1 if there isn't a
+    // valid record there.
+    qint64 archiveEndAt(qint64 pos);
+};
+
+QByteArray utils::ZipFileReaderPrivate::read(qint64 pos, qint64 size)
+{
+    if (pos < 0 || size < 0 || pos + size > file.size())
+    {
+        return {};
+    }
+    if (mapped)
+    {
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(mapped + pos), size);
+    }
+    return file.seek(pos) ? file.read(size) : QByteArray();
+}
+
+qint64 utils::ZipFileReaderPrivate::findLastArchiveEnd()
+{
+    const QByteArray signature("PK\x05\x06", 4);
+    const qint64 chunkSize = 1 << 20;
+    const qint64 fileSize = file.size();
+
+    for (qint64 chunkEnd = fileSize; chunkEnd > 0;)
+    {
+        // Each chunk finds the signatures that start in it so it overlaps the next chunk by up to 3 bytes
+        const qint64 chunkStart = std::max<qint64>(chunkEnd - chunkSize, 0);
+        const QByteArray chunk = read(chunkStart, std::min(chunkEnd + signature.size() - 1, fileSize) - chunkStart);
+
+        for (qsizetype i = chunk.lastIndexOf(signature); i >= 0; i = (i > 0) ? chunk.lastIndexOf(signature, i - 1) : -1)
         {
-            qCritical() << "Unable to open minizip memory stream for writing. Error code:" << err;
-            return {};
+            if (const qint64 end = archiveEndAt(chunkStart + i); end > 0)
+            {
+                return end;
+            }
+        }
+        chunkEnd = chunkStart;
+    }
+    return -1;
+}
+
+qint64 utils::ZipFileReaderPrivate::archiveEndAt(qint64 pos)
+{
+    const qint64 recordSize = 22;
+    const qint64 zip64LocatorSize = 20;
+    const qint64 zip64RecordSize = 56;
+    const quint32 zip64LocatorSignature = 0x07064b50;
+    const quint32 zip64RecordSignature = 0x06064b50;
+    const quint32 centralHeaderSignature = 0x02014b50;
+
+    const QByteArray record = read(pos, recordSize);
+    if (record.size() != recordSize)
+    {
+        return -1;
+    }
+    const auto *recordData = reinterpret_cast<const uchar *>(record.constData());
+    const qint64 end = pos + recordSize + qFromLittleEndian<quint16>(recordData + 20);
+    qint64 cdSize = qFromLittleEndian<quint32>(recordData + 12);
+    qint64 cdOffset = qFromLittleEndian<quint32>(recordData + 16);
+    qint64 cdEnd = pos;
+
+    // Zip64 archives have a zip64 end of central directory record (found through the locator before this
+    // record) between the central directory and this record
+    if (const QByteArray locator = read(pos - zip64LocatorSize, zip64LocatorSize);
+        locator.size() == zip64LocatorSize
+        && qFromLittleEndian<quint32>(locator.constData()) == zip64LocatorSignature)
+    {
+        cdEnd = qFromLittleEndian<qint64>(locator.constData() + 8);
+        const QByteArray record64 = read(cdEnd, zip64RecordSize);
+        if (record64.size() != zip64RecordSize
+            || qFromLittleEndian<quint32>(record64.constData()) != zip64RecordSignature)
+        {
+            return -1;
         }
-        mz_stream_mem_seek(memStream.get(), 0, MZ_SEEK_SET);
+        cdSize = qFromLittleEndian<qint64>(record64.constData() + 40);
+        cdOffset = qFromLittleEndian<qint64>(record64.constData() + 48);
+    }
 
-        if (err = mz_zip_writer_open(zipWriter.get(), memStream.get(), 0); err != MZ_OK)
+    if (end > file.size() || cdOffset < 0 || cdSize < 0 || cdOffset + cdSize != cdEnd)
+    {
+        return -1;
+    }
+    if (cdSize > 0)
+    {
+        const QByteArray header = read(cdOffset, 4);
+        if (header.size() != 4 || qFromLittleEndian<quint32>(header.constData()) != centralHeaderSignature)
         {
-            qCritical() << "Unable to open minizip ZipWriter. Error code:" << err;
-            return {};
+            return -1;
         }
+    }
+    return end;
+}
 
-        for (auto *entry : prunedEntries(m_fileEntries))
+qint64 utils::ZipFileReaderPrivate::dataOffset(const EntryInfo &entry)
+{
+    const qint64 localHeaderSize = 30;
+    const quint32 localHeaderSignature = 0x04034b50;
+    const qint64 fileSize = file.size();
+
+    QByteArray headerData;
+    const uchar *header = nullptr;
+
+    if (mapped)
+    {
+        if (entry.headerOffset < 0 || entry.headerOffset + localHeaderSize > fileSize)
         {
-            writeEntry(zipWriter, *entry);
+            return -1;
         }
+        header = mapped + entry.headerOffset;
+    }
+    else
+    {
+        if (!file.seek(entry.headerOffset) || (headerData = file.read(localHeaderSize)).size() != localHeaderSize)
+        {
+            return -1;
+        }
+        header = reinterpret_cast<const uchar *>(headerData.constData());
+    }
 
-        mz_zip_writer_close(zipWriter.get());
+    if (qFromLittleEndian<quint32>(header) != localHeaderSignature)
+    {
+        return -1;
     }
+    const quint16 filenameLength = qFromLittleEndian<quint16>(header + 26);
+    const quint16 extraFieldLength = qFromLittleEndian<quint16>(header + 28);
+
+    const qint64 offset = entry.headerOffset + localHeaderSize + filenameLength + extraFieldLength;
+    return (offset + entry.compressedSize <= fileSize) ? offset : -1;
+}
 
-    // TODO: Total file size > INT32_MAX not supported
+ZipFileReader::ZipFileReader()
+    : p(std::make_unique<ZipFileReaderPrivate>())
+{}
 
-    const void *buf = nullptr;
-    if (err = mz_stream_mem_get_buffer(memStream.get(), &buf); err != MZ_OK)
+ZipFileReader::~ZipFileReader() = default;
+
+ZipFileReader::ZipFileReader(ZipFileReader &&other) noexcept = default;
+ZipFileReader &ZipFileReader::operator=(ZipFileReader &&other) noexcept = default;
+
+bool ZipFileReader::open(const QString &filepath)
+{
+    close();
+
+    p->file.setFileName(filepath);
+    if (!p->file.open(QIODevice::ReadOnly))
     {
-        qCritical() << "Unable to get minizip memory stream buffer. Error code:" << err;
-        return {};
+        qCritical() << "Unable to open" << filepath << "for reading";
+        return false;
+    }
+
+    // If mapping fails then entries are read from the file instead
+    p->mapped = p->file.map(0, p->file.size());
+    if (!p->mapped)
+    {
+        qWarning() << "Unable to memory map" << filepath << p->file.errorString();
     }
 
-    int32_t bufSize = 0;
-    mz_stream_mem_get_buffer_length(memStream.get(), &bufSize);
+    p->stream = createDeviceStream(&p->file);
 
-    QByteArray out(static_cast<const char *>(buf), bufSize);
-    return out;
+    int32_t err = mz_zip_reader_open(p->zipReader.get(), &p->stream);
+    if (err != MZ_OK)
+    {
+        // An interrupted append (see ZipFileWriter::open) leaves a partly written archive after the previous
+        // one. minizip only searches the end of the file for the end of central directory record, so read
+        // the file as if it ends where the previous archive does.
+        if (const qint64 end = p->findLastArchiveEnd(); end > 0)
+        {
+            qWarning() << filepath << "has incomplete data after" << end << "bytes. It's ignored.";
+            mz_zip_reader_close(p->zipReader.get());
+            p->stream.size = end;
+            err = mz_zip_reader_open(p->zipReader.get(), &p->stream);
+        }
+    }
+    if (err != MZ_OK)
+    {
+        qCritical() << "minizip: Error opening" << filepath << "for reading" << err;
+        close();
+        return false;
+    }
+
+    // Index the central directory
+    err = mz_zip_reader_goto_first_entry(p->zipReader.get());
+    while (err == MZ_OK)
+    {
+        mz_zip_file *fileInfo = nullptr;
+        if (mz_zip_reader_entry_get_info(p->zipReader.get(), &fileInfo) == MZ_OK)
+        {
+            const QString cleanName = cleanPath(QString::fromUtf8(fileInfo->filename));
+            if (!p->entries.contains(cleanName))
+            {
+                p->filenames.push_back(cleanName);
+            }
+            p->entries.insert(cleanName, {fileInfo->filename, fileInfo->disk_offset, fileInfo->compressed_size,
+                                          fileInfo->uncompressed_size, fileInfo->compression_method});
+        }
+        err = mz_zip_reader_goto_next_entry(p->zipReader.get());
+    }
+
+    if (err != MZ_END_OF_LIST)
+    {
+        qCritical() << "Error reading the central directory of" << filepath << err;
+        close();
+        return false;
+    }
+    return true;
 }
 
-void ZipFile::addFile(const QString &filename, const QByteArray &data)
+void ZipFileReader::close()
 {
-    addFile(filename, std::move(QByteArray(data)));
+    mz_zip_reader_close(p->zipReader.get());
+
+    if (p->mapped)
+    {
+        p->file.unmap(p->mapped);
+        p->mapped = nullptr;
+    }
+    p->file.close();
+
+    p->filenames.clear();
+    p->entries.clear();
 }
 
-void ZipFile::addFile(const QString &filename, QByteArray &&data)
+bool ZipFileReader::isOpen() const
 {
-    const QString cleanName = cleanPath(filename);
+    return p->file.isOpen();
+}
+
+QList<QString> ZipFileReader::filenames() const
+{
+    return p->filenames;
+}
 
-    for (auto &entry : m_fileEntries)
+QByteArray ZipFileReader::getFile(const QString &filename) const
+{
+    const auto found = p->entries.constFind(cleanPath(filename));
+    if (found == p->entries.cend())
+    {
+        return {};
+    }
+    const ZipFileReaderPrivate::EntryInfo &entry = found.value();
+
+    if (entry.compressionMethod != MZ_COMPRESS_METHOD_STORE)
     {
-        if (entry.filename == cleanName)
+        // Compressed entries need to be inflated by minizip
+        if (const int32_t err = mz_zip_reader_locate_entry(p->zipReader.get(), entry.rawFilename.constData(), 0);
+            err != MZ_OK)
         {
-            entry = std::move(FileEntry(cleanName, std::move(data)));
-            return;
+            qCritical() << "Unable to locate zip entry" << filename << "(" << err << ")";
+            return {};
         }
+        return readEntryData(p->zipReader);
     }
-    m_fileEntries.push_back({cleanName, std::move(data)});
+
+    const qint64 offset = p->dataOffset(entry);
+    if (offset < 0)
+    {
+        qCritical() << "Invalid local header for zip entry" << filename;
+        return {};
+    }
+
+    if (p->mapped)
+    {
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(p->mapped + offset), entry.compressedSize);
+    }
+    if (!p->file.seek(offset))
+    {
+        return {};
+    }
+    return p->file.read(entry.compressedSize);
 }
 
-const QByteArray &utils::ZipFile::getFile(const QString &filename) const
+bool ZipFileReader::hasFile(const QString &filename) const
 {
-    static const QByteArray nullArray; // Returned if the file can't be found
+    return p->entries.contains(cleanPath(filename));
+}
 
-    const QString cleanName = cleanPath(filename);
+struct utils::ZipFileWriterPrivate
+{
+    DeviceStream stream = {};
+    ZipWriter zipWriter;
+    QSet<QString> filenames;
+    bool isOpen = false;
+};
 
-    for (const auto &entry : m_fileEntries)
+ZipFileWriter::ZipFileWriter()
+    : p(std::make_unique<ZipFileWriterPrivate>())
+{}
+
+ZipFileWriter::~ZipFileWriter()
+{
+    if (p)
     {
-        if (entry.filename == cleanName)
-        {
-            return entry.data;
-        }
+        close();
     }
-    return nullArray;
 }
 
-bool ZipFile::hasFile(const QString &filename) const
+ZipFileWriter::ZipFileWriter(ZipFileWriter &&other) noexcept = default;
+ZipFileWriter &ZipFileWriter::operator=(ZipFileWriter &&other) noexcept = default;
+
+bool ZipFileWriter::open(QIODevice *device, bool append)
 {
+    close();
+
+    if (!device || !device->isWritable() || device->isSequential())
+    {
+        qCritical() << "Zip files can only be written to seekable devices open for writing";
+        return false;
+    }
+    if (append && !device->isReadable())
+    {
+        qCritical() << "Zip files can only be appended to devices open for reading and writing";
+        return false;
+    }
+
+    p->stream = createDeviceStream(device);
+    mz_zip_writer_set_compress_method(p->zipWriter.get(), compressMethod);
+    mz_zip_writer_set_compress_level(p->zipWriter.get(), compressLevel);
+
+    if (const int32_t err = mz_zip_writer_open(p->zipWriter.get(), &p->stream, append ? 1 : 0); err != MZ_OK)
+    {
+        qCritical() << "Unable to open minizip ZipWriter. Error code:" << err;
+        return false;
+    }
+
+    // minizip appends over the existing central directory. Appending after the end of the file instead keeps the
+    // old central directory valid until the new end of central directory record is written, so the file can
+    // still be read if writing is interrupted. The old directory is left as unused bytes between entries.
+    if (append && !device->seek(device->size()))
+    {
+        qCritical() << "Unable to seek to the end of the zip file";
+        mz_zip_writer_close(p->zipWriter.get());
+        return false;
+    }
+
+    p->isOpen = true;
+    return true;
+}
+
+bool ZipFileWriter::close()
+{
+    if (!p->isOpen)
+    {
+        return false;
+    }
+    p->isOpen = false;
+    p->filenames.clear();
+
+    if (const int32_t err = mz_zip_writer_close(p->zipWriter.get()); err != MZ_OK)
+    {
+        qCritical() << "Error writing zip central directory. Error code:" << err;
+        return false;
+    }
+    return true;
+}
+
+bool ZipFileWriter::isOpen() const
+{
+    return p->isOpen;
+}
+
+bool ZipFileWriter::addFile(const QString &filename, const QByteArray &data)
+{
+    if (!p->isOpen)
+    {
+        return false;
+    }
+
     const QString cleanName = cleanPath(filename);
+    if (p->filenames.contains(cleanName))
+    {
+        qWarning() << "Zip entry" << cleanName << "has already been written";
+        return false;
+    }
+    p->filenames.insert(cleanName);
 
-    return std::ranges::any_of(m_fileEntries, [cleanName](const FileEntry &x)
-                               { return x.filename == cleanName; });
+    return writeEntry(p->zipWriter, cleanName, data);
 }
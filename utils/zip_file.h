@@ -1,12 +1,18 @@
 #pragma once
 
+#include <memory>
+
+#include <QtCore/QHash>
 #include <QtCore/QList>
 
 class QByteArray;
+class QIODevice;
 class QString;
 
 namespace utils
 {
+    struct ZipFileReaderPrivate;
+    struct ZipFileWriterPrivate;
 
     class ZipFile
     {
@@ -18,7 +24,10 @@ namespace utils
         };
 
     private:
+        // In the order they were first added, which is the order they're written in
         QList<FileEntry> m_fileEntries;
+        // Index in m_fileEntries of each entry by filename
+        QHash<QString, qsizetype> m_indices;
 
     public:
         ZipFile() = default;
@@ -43,4 +52,67 @@ namespace utils
 
     inline bool ZipFile::isEmpty() const { return m_fileEntries.isEmpty(); }
 
+    // Reads a zip file from disk without loading the whole file into memory. The file is memory
+    // mapped and only its central directory is read by open. Entry data is only read when requested.
+    class ZipFileReader
+    {
+        std::unique_ptr<ZipFileReaderPrivate> p;
+
+    public:
+        ZipFileReader();
+        ~ZipFileReader();
+
+        ZipFileReader(const ZipFileReader &) = delete;
+        ZipFileReader &operator=(const ZipFileReader &) = delete;
+
+        ZipFileReader(ZipFileReader &&other) noexcept;
+        ZipFileReader &operator=(ZipFileReader &&other) noexcept;
+
+        bool open(const QString &filepath);
+        void close();
+        bool isOpen() const;
+
+        // The names of all entries in the order they appear in the central directory
+        QList<QString> filenames() const;
+
+        // Returns the data of the entry filename or an empty array if it is not found.
+        // Entries stored without compression are not copied but refer directly to the mapped file.
+        // So the returned array is only valid until the reader is closed (call QByteArray::detach to
+        // keep a copy).
+        QByteArray getFile(const QString &filename) const;
+        bool hasFile(const QString &filename) const;
+    };
+
+    // Writes a zip file directly to a QIODevice as entries are added, so the archive is never held in
+    // memory. The device must be open for writing and seekable.
+    class ZipFileWriter
+    {
+        std::unique_ptr<ZipFileWriterPrivate> p;
+
+    public:
+        ZipFileWriter();
+        ~ZipFileWriter();
+
+        ZipFileWriter(const ZipFileWriter &) = delete;
+        ZipFileWriter &operator=(const ZipFileWriter &) = delete;
+
+        ZipFileWriter(ZipFileWriter &&other) noexcept;
+        ZipFileWriter &operator=(ZipFileWriter &&other) noexcept;
+
+        // If append is true then device must be readable and contain a zip file. Entries and a new central
+        // directory are added after the end of the file instead of overwriting it. The existing central directory
+        // is left in place so if writing is interrupted ZipFileReader can still read the file as it was before
+        // (it ignores the incomplete data at the end).
+        // An appended entry with the same name as an existing one supersedes it (ZipFileReader uses
+        // the last entry with a given name) but the old entry's data is not removed.
+        bool open(QIODevice *device, bool append = false);
+        // Writes the central directory. Returns false if it could not be written.
+        bool close();
+        bool isOpen() const;
+
+        // Writes the entry to the device straight away. Entries can't be replaced once written so
+        // duplicate filenames are skipped.
+        bool addFile(const QString &filename, const QByteArray &data);
+    };
+
 } // namespace utils
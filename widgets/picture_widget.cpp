@@ -150,8 +150,15 @@ void PictureWidget::paintEvent(QPaintEvent *event)
     if (m_imageSP.isNull() || !m_imageSP->isLoaded())
     {
         // If an error occurred during loading then draw the error message
-        const QString msg = (m_imageSP && !m_imageSP->errorMessage().isEmpty()) ? m_imageSP->errorMessage()
-                                                                                : "Drag and drop an image here";
+        QString msg = "Drag and drop an image here";
+        if (m_imageSP && !m_imageSP->errorMessage().isEmpty())
+        {
+            msg = m_imageSP->errorMessage();
+        }
+        else if (m_imageSP && m_imageSP->isLoading())
+        {
+            msg = "Loading...";
+        }
         painter.setOpacity(std::max(minOpacity, opacityMultiplier()));
         painter.fillRect(destRect, Qt::lightGray);
         drawMessage(painter, rect(), msg);
@@ -183,11 +190,10 @@ void PictureWidget::paintEvent(QPaintEvent *event)
                                                             : QPainter::CompositionMode_Source);
 
         const auto lock = refImage.lockDisplayImage();
-        const QPixmap &dispImage = refImage.displayImage();
 
         cachePainter.setRenderHint(QPainter::SmoothPixmapTransform, refImage.smoothFiltering());
 
-        cachePainter.drawPixmap(destRect, dispImage, refImage.displayImageCrop());
+        refImage.drawDisplayImage(cachePainter, destRect);
         m_cacheInvalidated = false;
     }
 
@@ -234,7 +240,13 @@ QPointF PictureWidget::localToDisplayImage(const QPointF &localPos) const
     const QRect dispCrop = m_imageSP->displayImageCrop();
     const qreal sizeRatio = dispCrop.width() / static_cast<qreal>(width());
 
-    return localPos * sizeRatio + dispCrop.topLeft().toPointF();
+    // Undo any flips applied when painting the display image
+    const utils::ImageEffects paintEffects = m_imageSP->paintEffects();
+    QPointF pos = localPos;
+    if (paintEffects.flipHorizontal) pos.setX(width() - localPos.x());
+    if (paintEffects.flipVertical) pos.setY(height() - localPos.y());
+
+    return pos * sizeRatio + dispCrop.topLeft().toPointF();
 }
 
 QPointF PictureWidget::baseImageToLocal(const QPointF &basePos) const
@@ -252,7 +264,12 @@ QPointF PictureWidget::baseImageToLocal(const QPointF &basePos) const
 
 QSize PictureWidget::sizeHint() const
 {
-    return (m_imageSP && m_imageSP->isLoaded()) ? m_imageSP->displaySize() : defaultSizeHint;
+    // N.B. An image that is still loading may already have a display size (e.g. restored from a session)
+    if (m_imageSP && (m_imageSP->isLoaded() || !m_imageSP->displaySize().isEmpty()))
+    {
+        return m_imageSP->displaySize();
+    }
+    return defaultSizeHint;
 }
 
 void PictureWidget::setImage(const ReferenceImageSP &image)
@@ -5,6 +5,7 @@
 #include <QtGui/QShortcut>
 
 #include <QtWidgets/QCheckBox>
+#include <QtWidgets/QComboBox>
 #include <QtWidgets/QDoubleSpinBox>
 #include <QtWidgets/QFormLayout>
 #include <QtWidgets/QGridLayout>
@@ -21,6 +22,7 @@
 #include "../app.h"
 #include "../global_hotkeys.h"
 #include "../preferences.h"
+#include "../undo_stack.h"
 
 #include "main_toolbar.h"
 
@@ -201,6 +203,7 @@ namespace
         QWidget *createWidgetBool();
         QWidget *createWidgetFloat();
         QWidget *createWidgetInt();
+        QWidget *createWidgetEnum();
 
         QWidget *parentWidget() { return m_layout ? m_layout->parentWidget() : nullptr; }
 
@@ -281,6 +284,40 @@ namespace
         return spinBox;
     }
 
+    QWidget *PrefWidgetMaker::createWidgetEnum()
+    {
+        QScopedPointer<QHBoxLayout> hbox(new QHBoxLayout());
+
+        auto *label = new QLabel(m_name + ":", parentWidget());
+        label->setToolTip(m_description);
+
+        auto *comboBox = new QComboBox(parentWidget());
+        comboBox->setToolTip(m_description);
+
+        const QString &current = m_prefs->getEnumItem(m_key).identifier;
+        for (int i = 0; i < Preferences::getEnumCount(m_key); ++i)
+        {
+            const PrefEnumItem &item = Preferences::getEnumItem(m_key, i);
+            comboBox->addItem(item.name, item.identifier);
+            if (item.identifier == current)
+            {
+                comboBox->setCurrentIndex(i);
+            }
+        }
+
+        hbox->addWidget(label);
+        hbox->addWidget(comboBox);
+
+        const auto key = m_key;
+        auto *prefs = m_prefs;
+
+        QObject::connect(comboBox, &QComboBox::currentIndexChanged, parentWidget(),
+                         [=]() { prefs->setString(key, comboBox->currentData().toString()); });
+
+        m_layout->addLayout(hbox.take());
+        return comboBox;
+    }
+
     PrefWidgetMaker::PrefWidgetMaker(QBoxLayout *layout, Preferences *prefs)
         : m_layout(layout),
           m_prefs(prefs)
@@ -311,6 +348,14 @@ namespace
         case QMetaType::Int:
             return createWidgetInt();
 
+        case QMetaType::QString:
+            if (Preferences::getEnumCount(key) > 0)
+            {
+                return createWidgetEnum();
+            }
+            qCritical() << "Only enum string preferences have widgets" << key;
+            return nullptr;
+
         case QMetaType::UnknownType:
         case QMetaType::Void:
             qCritical() << "Unable to find preference key" << key;
@@ -388,6 +433,27 @@ namespace
         return widget;
     }
 
+    // Shows the number of undo steps and the memory they use
+    QWidget *createUndoUsageWidget(PrefLayoutType *layout)
+    {
+        auto *label = new QLabel(layout->parentWidget());
+        const UndoStack *undoStack = UndoStack::get();
+
+        const auto updateText = [label, undoStack]()
+        {
+            const qreal megabytes = static_cast<qreal>(undoStack->memoryUsage()) / (1024 * 1024);
+            label->setText(QString("Undo history: %1 undo and %2 redo steps using %3 MB")
+                               .arg(undoStack->undoCount())
+                               .arg(undoStack->redoCount())
+                               .arg(megabytes, 0, 'f', 1));
+        };
+        updateText();
+        QObject::connect(undoStack, &UndoStack::stepsChanged, label, updateText);
+
+        layout->addWidget(label);
+        return label;
+    }
+
     void deleteUI(QWidget *widget)
     {
         for (auto *obj : widget->children())
@@ -556,6 +622,7 @@ void PreferencesWindow::buildUI()
 
         widgetMaker.createWidget(Preferences::AllowInternet);
         widgetMaker.createWidget(Preferences::AskSaveBeforeClosing);
+        widgetMaker.createWidget(Preferences::AutosaveIntervalMins);
         widgetMaker.createWidget(Preferences::AnimateToolbarCollapse);
         widgetMaker.createWidget(Preferences::GhostModeOpacity);
         createOverrideKeyWidget(layout, m_prefs);
@@ -574,6 +641,14 @@ void PreferencesWindow::buildUI()
         widgetMaker.createWidget(Preferences::LocalFilesLink);
         widgetMaker.createWidget(Preferences::LocalFilesStoreMaxMB);
         widgetMaker.createWidget(Preferences::UndoMaxSteps);
+        widgetMaker.createWidget(Preferences::UndoMaxMemoryMB);
+        createUndoUsageWidget(layout);
+        widgetMaker.createWidget(Preferences::PaintTimeEffects);
+        widgetMaker.createWidget(Preferences::RedrawThreads);
+        widgetMaker.createWidget(Preferences::ImageMemoryBudgetMB);
+        widgetMaker.createWidget(Preferences::PrefetchTabs);
+        widgetMaker.createWidget(Preferences::StoredImageFormat);
+        widgetMaker.createWidget(Preferences::StoredImageCompression);
         layout->addStretch();
     }
 
@@ -10,6 +10,7 @@
 #include <QtGui/QDragEnterEvent>
 #include <QtGui/QDropEvent>
 #include <QtGui/QPainter>
+#include <QtGui/QShowEvent>
 
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QGridLayout>
@@ -274,7 +275,18 @@ void ReferenceWindow::addReference(const ReferenceImageSP &refItem, bool clampSi
 
     if (clampSize)
     {
-        clampReferenceSize(refItem);
+        if (refItem->isLoaded())
+        {
+            clampReferenceSize(refItem);
+        }
+        else
+        {
+            // The image is still loading so clamp its size once the base image is set
+            QObject::connect(
+                refItem.get(), &ReferenceImage::baseImageChanged, this,
+                [this, weakRef = refItem.toWeakRef()]() { clampReferenceSize(weakRef.toStrongRef()); },
+                Qt::SingleShotConnection);
+        }
     }
     emit referenceAdded(refItem);
 
@@ -405,7 +417,7 @@ bool ReferenceWindow::copyActiveToClipboard() const
 
         painter.setRenderHint(QPainter::SmoothPixmapTransform, refImage->smoothFiltering());
 
-        painter.drawPixmap(imageData.rect(), refImage->displayImage(), imgCrop);
+        refImage->drawDisplayImage(painter, imageData.rect());
     }
     if (!imageData.isNull())
     {
@@ -543,6 +555,11 @@ void ReferenceWindow::setActiveImage(const ReferenceImageSP &image)
         }
         emit activeImageChanged(m_activeImage);
         adjustSize();
+
+        if (isVisible())
+        {
+            prefetchTabs();
+        }
     }
 }
 
@@ -556,7 +573,7 @@ void ReferenceWindow::clampReferenceSize(const ReferenceImageSP &refItem)
     const ReferenceImageSP &activeRef = activeImage();
     QSize newSize;
 
-    if (activeRef && activeRef->isLoaded())
+    if (activeRef && activeRef != refItem && activeRef->isLoaded())
     {
         newSize = refSize.scaled(activeRef->displaySize(), Qt::KeepAspectRatio);
     }
@@ -572,6 +589,33 @@ void ReferenceWindow::clampReferenceSize(const ReferenceImageSP &refItem)
     }
 }
 
+void ReferenceWindow::prefetchTabs()
+{
+    // Queued before the other tabs so it's decoded first
+    if (const ReferenceImageSP &active = activeImage(); active && !active->isLoaded())
+    {
+        active->restoreBaseImage();
+    }
+
+    const int activeIndex = m_tabBar->indexOf(activeImage());
+    if (activeIndex < 0)
+    {
+        return;
+    }
+
+    const int prefetchCount = appPrefs()->getInt(Preferences::PrefetchTabs);
+    for (int i = activeIndex - prefetchCount; i <= activeIndex + prefetchCount; i++)
+    {
+        if (i != activeIndex && i >= 0 && i < m_tabBar->count())
+        {
+            if (const ReferenceImageSP refItem = m_tabBar->referenceAt(i); refItem && !refItem->isLoaded())
+            {
+                refItem->restoreBaseImage();
+            }
+        }
+    }
+}
+
 void ReferenceWindow::drawHighlightedBorder()
 {
     // Draw a border that lerps between two colors
@@ -873,6 +917,12 @@ void ReferenceWindow::paintEvent(QPaintEvent *event)
     }
 }
 
+void ReferenceWindow::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    prefetchTabs();
+}
+
 void ReferenceWindow::wheelEvent(QWheelEvent *event)
 {
     QWidget::wheelEvent(event);
@@ -113,11 +113,17 @@ protected:
     void focusInEvent(QFocusEvent *event) override;
     void focusOutEvent(QFocusEvent *event) override;
     void paintEvent(QPaintEvent *event) override;
+    void showEvent(QShowEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
 
 private:
     void clampReferenceSize(const ReferenceImageSP &refItem);
     void drawHighlightedBorder();
+    // Starts decoding the active image and the images of the tabs next to it (see Preferences::PrefetchTabs)
+    // if they were evicted or haven't been decoded yet. Called when the window is shown or the active image
+    // changes so images are never decoded from a paint event. The loading message is drawn until they're
+    // decoded.
+    void prefetchTabs();
     qreal ghostOpacity() const;
     SettingsPanel *settingsPanel() const;
     void setMergeDest(ReferenceWindow *target);
@@ -307,7 +307,7 @@ namespace
         QObject::connect(resetBtn, &QPushButton::clicked, settingsPanel, [=]() {
             if (const ReferenceImageSP &refImage = settingsPanel->referenceImage(); refImage)
             {
-                settingsPanel->refWindow()->setCrop(refImage->baseImage().rect());
+                settingsPanel->refWindow()->setCrop(QRect(QPoint(), refImage->baseImageSize()));
             }
         });
         hbox->addWidget(resetBtn);